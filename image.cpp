@@ -1,85 +1,186 @@
 #include <sstream>
 #include <iomanip>
 #include <iostream>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
 
 #include "image.h"
+#include "params.h"
+#include "thread_pool.h"
+#include "isa.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "include/stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "include/stb_image_write.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if ISA_DISPATCH
+#include <immintrin.h>
+#endif
+
 #define clamp(start, x, end) std::min(std::max(start, x), end)
 
 
+// Sample loading.
+
+// Load the samples of an image file (8 bits, 16 bits or linear float samples, the int16 samples widening the 8 bits ones).
+static uint8_t* load_samples(const char* filename, int* width, int* height, int* channels, const int channel_force, uint8_t*) {
+    return stbi_load(filename, width, height, channels, channel_force);
+}
+
+static uint16_t* load_samples(const char* filename, int* width, int* height, int* channels, const int channel_force, uint16_t*) {
+    return stbi_load_16(filename, width, height, channels, channel_force);
+}
+
+static int16_t* load_samples(const char* filename, int* width, int* height, int* channels, const int channel_force, int16_t*) {
+    uint8_t* data = stbi_load(filename, width, height, channels, channel_force);
+    if (data == NULL) { return NULL; }
+
+    // Widen the samples into a buffer freed by stbi_image_free.
+    const size_t size = (size_t)*width * *height * (channel_force == 0 ? *channels : channel_force); // Number of samples.
+    int16_t* samples = (int16_t*)malloc(size * sizeof(int16_t));
+    for (size_t i = 0; samples != NULL && i < size; i++) { samples[i] = data[i]; }
+    stbi_image_free(data);
+
+    return samples;
+}
+
+static float* load_samples(const char* filename, int* width, int* height, int* channels, const int channel_force, float*) {
+    // The 8 bits files are scaled to [0, 1] without a gamma curve, so that they are saved back unchanged (to_uint8 is linear).
+    stbi_ldr_to_hdr_gamma(1.0f);
+    stbi_ldr_to_hdr_scale(1.0f);
+    stbi_hdr_to_ldr_gamma(1.0f);
+    return stbi_loadf(filename, width, height, channels, channel_force);
+}
+
+
+// Shared pixel buffer.
+
+// Reference-counted pixel buffer, immutable while shared, with the images derived from it cached alongside.
+template <typename T>
+struct BasicImage<T>::Buffer {
+    // Pixel data.
+    T* data = NULL;
+
+    // Mutex guarding the cache.
+    std::mutex mutex;
+
+    // Whether any derived image is cached (checked without locking before mutations).
+    std::atomic<bool> has_cache{false};
+
+    // Pixel buffer converted to the other architecture.
+    std::shared_ptr<Buffer> converted;
+
+    // Padded images by (padding width, padding height, padding type, channel mask).
+    std::map<std::tuple<int, int, int, uint32_t>, BasicImage<T>> padded;
+
+    ~Buffer() {
+        // Free the pixel data.
+        delete[] data;
+    }
+};
+
+
 // Constructors and destructor.
 
-Image::Image(const char *filename, const int channel_force, const bool is_SoA) : is_SoA(is_SoA) {
+template <typename T>
+BasicImage<T>::BasicImage(const char *filename, const int channel_force, const bool is_SoA) : is_SoA(is_SoA) {
     // Load the image.
     if (!load_image(filename, channel_force)) {
         std::cerr << "Error: Failed to read " << filename << "." << std::endl;
         throw std::runtime_error("Failed to read " + std::string(filename) + ".");
     } else {
-        printf("Read %s:\n\tWidth: %dpx\n\tHeight: %dpx\n\tChannels: %d\n\tArchitecture: %s\n\n", filename, width, height, channels, is_SoA ? "SoA" : "AoS");
+        printf("Read %s:\n\tWidth: %dpx\n\tHeight: %dpx\n\tChannels: %d\n\tArchitecture: %s\n\tGrayscale: %s\n\n", filename, width, height, channels, is_SoA ? "SoA" : "AoS", is_grayscale ? "yes" : "no");
     }
 }
 
-Image::Image(const int width, const int height, const int channels, const bool is_SoA) : width(width), height(height), channels(channels), is_SoA(is_SoA) {
-    // Get the size of the image.
-    size_t size = get_size();
-    
-    // Allocate memory for the image.
-    data = new uint8_t[size]{0};
+template <typename T>
+BasicImage<T>::BasicImage(const int width, const int height, const int channels, const bool is_SoA) : width(width), height(height), channels(channels), is_SoA(is_SoA) {
+    // Allocate zero initialized memory for the image.
+    buffer = allocate(get_size(), true);
 }
 
-Image::Image(const int width, const int height, const int channels, uint8_t* data, const bool is_SoA) : Image(width, height, channels, is_SoA) {
-    // Get the size of the image.
-    size_t size = get_size();
-    
+template <typename T>
+BasicImage<T>::BasicImage(const int width, const int height, const int channels, const T* data, const bool is_SoA) : BasicImage(width, height, channels, is_SoA, allocate((size_t)width * height * channels, false)) {
     // Copy the image data.
-    memcpy(this->data, data, size * sizeof(uint8_t));
+    memcpy(buffer->data, data, get_size() * sizeof(T));
 }
 
-Image::Image(const Image &image) : Image(image.width, image.height, image.channels, image.is_SoA) {
-    // Get the size of the image.
-    size_t size = get_size();
+template <typename T>
+BasicImage<T>::BasicImage(const BasicImage &image) : width(image.width), height(image.height), channels(image.channels), buffer(image.buffer), is_SoA(image.is_SoA), is_grayscale(image.is_grayscale) {
+    // The pixel buffer is shared: nothing to copy.
+}
 
-    // Copy the image data.
-    memcpy(data, image.data, size * sizeof(uint8_t));
+template <typename T>
+BasicImage<T>::BasicImage(const int width, const int height, const int channels, const bool is_SoA, const std::shared_ptr<Buffer>& buffer) : width(width), height(height), channels(channels), buffer(buffer), is_SoA(is_SoA) {
+}
+
+template <typename T>
+BasicImage<T> BasicImage<T>::uninitialized(const int width, const int height, const int channels, const bool is_SoA) {
+    return BasicImage(width, height, channels, is_SoA, allocate((size_t)width * height * channels, false));
 }
 
-Image::~Image() {
-    // Free the image data.
-    delete[] data;
+template <typename T>
+BasicImage<T>::~BasicImage() {
+    // The pixel buffer is freed with its last reference.
 }
 
 
 // Getters.
 
-int Image::get_width() const {
+template <typename T>
+int BasicImage<T>::get_width() const {
     return width;
 }
 
-int Image::get_height() const {
+template <typename T>
+int BasicImage<T>::get_height() const {
     return height;
 }
 
-int Image::get_channels() const {
+template <typename T>
+int BasicImage<T>::get_channels() const {
     return channels;
 }
 
-size_t Image::get_size() const {
-    return (size_t)(width * height * channels);
+template <typename T>
+size_t BasicImage<T>::get_size() const {
+    return (size_t)width * height * channels;
+}
+
+template <typename T>
+const T* BasicImage<T>::get_data() const {
+    return buffer ? buffer->data : NULL;
 }
 
-uint8_t* Image::get_data() const {
-    return data;
+template <typename T>
+T* BasicImage<T>::get_data() {
+    // Unshare the buffer before handing out a mutable pointer.
+    detach();
+
+    return buffer ? buffer->data : NULL;
 }
 
-bool Image::get_is_SoA() const {
+template <typename T>
+bool BasicImage<T>::get_is_SoA() const {
     return is_SoA;
 }
 
-ImageType Image::get_image_type(const char *filename) const {
+template <typename T>
+bool BasicImage<T>::get_is_grayscale() const {
+    return is_grayscale;
+}
+
+template <typename T>
+ImageType BasicImage<T>::get_image_type(const char *filename) const {
     // Get the file extension.
     const char* extension = strrchr(filename, '.');
 
@@ -93,6 +194,8 @@ ImageType Image::get_image_type(const char *filename) const {
             return ImageType::BMP;
         else if (strcmp(extension, ".tga") == 0)
             return ImageType::TGA;
+        else if (strcmp(extension, ".hdr") == 0)
+            return ImageType::HDR;
     }
 
     return ImageType::UNKNOWN;
@@ -101,9 +204,10 @@ ImageType Image::get_image_type(const char *filename) const {
 
 // Methods.
 
-bool Image::load_image(const char *filename, const int channel_force) {
+template <typename T>
+bool BasicImage<T>::load_image(const char *filename, const int channel_force) {
     // Load the image.
-    uint8_t* loaded_data = stbi_load(filename, &width, &height, &channels, channel_force);
+    T* loaded_data = load_samples(filename, &width, &height, &channels, channel_force, (T*)NULL);
 
     // Check if the image was loaded successfully.
     if (loaded_data != NULL) {
@@ -113,47 +217,120 @@ bool Image::load_image(const char *filename, const int channel_force) {
         // Get the size of the image.
         size_t size = get_size();
 
-        // Allocate memory for the image.
-        data = new uint8_t[size]{0};
+        // Allocate memory for the image (fully overwritten by the copy).
+        buffer = allocate(size, false);
 
         // Copy the image data.
-        memcpy(data, loaded_data, get_size() * sizeof(uint8_t));
+        memcpy(buffer->data, loaded_data, size * sizeof(T));
+
+        // Detect images whose color channels are identical.
+        is_grayscale = (channels >= 3) && detect_grayscale(buffer->data, (size_t)width * height, channels);
 
         // Convert to SoA if required.
-        if (is_SoA) { AoS_to_SoA(); }
+        const bool target_is_SoA = is_SoA;
+        is_SoA = false;
+        set_is_SoA(target_is_SoA);
     }
 
     // Free the loaded image.
     stbi_image_free(loaded_data);
 
-    return data != NULL;
+    return buffer != NULL;
 }
 
-void Image::save_image(const char* filename) {
-    // Convert to AoS if required.
-    if (is_SoA) { SoA_to_AoS(); }
+template <typename T>
+void BasicImage<T>::save_image(const char* filename) const {
+    // Interleave into a temporary buffer if required (the image itself is left in its architecture).
+    const T* data = get_data();
+    T* data_AoS = (T*)data;
+    if (is_SoA) {
+        data_AoS = new T[get_size()];
+        SoA_to_AoS(data, data_AoS, width, height, channels);
+    }
+
+    // Convert the wider samples to 8 bits (the 8 bits samples are saved as they are).
+    std::vector<uint8_t> converted_samples; // 8 bits samples.
+    const uint8_t* samples = (const uint8_t*)data_AoS; // Saved samples.
+    if (!std::is_same<T, uint8_t>::value) {
+        converted_samples.resize(get_size());
+        for (size_t i = 0; i < get_size(); i++) { converted_samples[i] = SampleTraits<T>::to_uint8(data_AoS[i]); }
+        samples = converted_samples.data();
+    }
 
     // Get the image type.
     ImageType type = get_image_type(filename);
 
     // Save the image.
     if (type == ImageType::PNG)
-        stbi_write_png(filename, width, height, channels, data, width * channels);
+        stbi_write_png(filename, width, height, channels, samples, width * channels);
     else if (type == ImageType::JPG || type == ImageType::JPEG)
-        stbi_write_jpg(filename, width, height, channels, data, 100);
+        stbi_write_jpg(filename, width, height, channels, samples, 100);
     else if (type == ImageType::BMP)
-        stbi_write_bmp(filename, width, height, channels, data);
+        stbi_write_bmp(filename, width, height, channels, samples);
     else if (type == ImageType::TGA)
-        stbi_write_tga(filename, width, height, channels, data);
-    else {
+        stbi_write_tga(filename, width, height, channels, samples);
+    else if (type == ImageType::HDR) {
+        // Linear float samples (the float samples are saved as they are).
+        std::vector<float> linear_samples(get_size()); // Float samples.
+        for (size_t i = 0; i < get_size(); i++) { linear_samples[i] = std::is_same<T, float>::value ? (float)data_AoS[i] : samples[i] / 255.0f; }
+        stbi_write_hdr(filename, width, height, channels, linear_samples.data());
+    } else {
+        if (data_AoS != data) { delete[] data_AoS; }
         std::cerr << "Error: Failed to save " << filename << "." << std::endl;
         throw std::runtime_error("Failed to save " + std::string(filename) + ".");
     }
 
+    // Free the temporary buffer.
+    if (data_AoS != data) { delete[] data_AoS; }
+
     std::cout << "Saving " << filename << "..." << std::endl;
 }
 
-Image Image::padding(const int padding_width, const int padding_height, const PaddingType padding_type) const {
+template <typename T>
+void BasicImage<T>::set_is_SoA(const bool is_SoA) {
+    // Switch to the (cached) converted buffer only if the architecture changes.
+    if (is_SoA != this->is_SoA) {
+        *this = converted(is_SoA);
+    }
+}
+
+template <typename T>
+BasicImage<T> BasicImage<T>::converted(const bool is_SoA) const {
+    // Same architecture: share the buffer.
+    if (is_SoA == this->is_SoA) {
+        return *this;
+    }
+
+    // Convert the buffer once and cache the result on it.
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    if (!buffer->converted) {
+        buffer->converted = allocate(get_size(), false);
+        copy_data(buffer->converted->data, is_SoA);
+        buffer->has_cache = true;
+    }
+
+    BasicImage image(width, height, channels, is_SoA, buffer->converted);
+    image.is_grayscale = is_grayscale;
+
+    return image;
+}
+
+template <typename T>
+void BasicImage<T>::copy_data(T* buffer, const bool is_SoA) const {
+    const T* data = get_data();
+
+    if (is_SoA == this->is_SoA) {
+        // Same architecture: plain copy.
+        memcpy(buffer, data, get_size() * sizeof(T));
+    } else if (is_SoA) {
+        AoS_to_SoA(data, buffer, width, height, channels);
+    } else {
+        SoA_to_AoS(data, buffer, width, height, channels);
+    }
+}
+
+template <typename T>
+BasicImage<T> BasicImage<T>::padding(const int padding_width, const int padding_height, const PaddingType padding_type, const uint32_t channel_mask) const {
     // Check if the padding dimensions are valid.
     if (padding_width < 0 || padding_height < 0) {
         std::cerr << "Error: Invalid padding dimensions: (" << padding_width << ", " << padding_height << ")." << std::endl;
@@ -164,69 +341,351 @@ Image Image::padding(const int padding_width, const int padding_height, const Pa
     const int padded_width = width + (padding_width * 2); // Padded width.
     const int padded_height = height + (padding_height * 2); // Padded height.
 
-    // Create the padded image.
-    Image padded_image(padded_width, padded_height, channels, is_SoA);
-
-    // Iterate over the input image.
-    for (int channel = 0; channel < channels; channel++) {
-        for (int y = 0; y < padded_height; y++) {
-            for (int x = 0; x < padded_width; x++) {
-                // Get the pixel index to be padded.
-                const int col = x - padding_width; // Column index.
-                const int row = y - padding_height; // Row index.
-                
-                // Verify if the pixel index is valid.
-                if (col >= 0 && col < width && row >= 0 && row < height) {
-                    // Set the padded pixel to the input pixel.
-                    padded_image(x, y, channel) = (*this)(col, row, channel);
+    // Reuse the padded image if it is already cached on the shared buffer.
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    const uint32_t all_channels = (channels >= 32) ? ALL_CHANNELS : ((1u << channels) - 1); // Mask of the image channels.
+    const uint32_t planes_mask = (is_SoA && (channel_mask & all_channels) != all_channels) ? (channel_mask & all_channels) : ALL_CHANNELS; // Padded planes (AoS pixels are padded whole).
+    const std::tuple<int, int, int, uint32_t> key(padding_width, padding_height, (int)padding_type, planes_mask); // Cache key.
+    const auto cached = buffer->padded.find(key);
+    if (cached != buffer->padded.end()) {
+        return cached->second;
+    }
+
+    // Create the padded image (fully overwritten below, no need to zero it).
+    BasicImage padded_image(padded_width, padded_height, channels, is_SoA, allocate((size_t)padded_width * padded_height * channels, false));
+
+    // Pad the image with the source index of every padded column and row.
+    padding_into(padded_image, padding_table(width, padding_width, padding_type), padding_table(height, padding_height, padding_type), padding_type, planes_mask);
+    padded_image.is_grayscale = is_grayscale;
+
+    // Cache the padded image on the shared buffer.
+    buffer->padded.emplace(key, padded_image);
+    buffer->has_cache = true;
+
+    return padded_image;
+}
+
+template <typename T>
+void BasicImage<T>::padding_into(BasicImage& padded_image, const std::vector<int>& column_table, const std::vector<int>& row_table, const PaddingType padding_type, const uint32_t channel_mask) const {
+    // Get the padded dimensions.
+    const int padded_width = padded_image.width; // Padded width.
+    const int padded_height = padded_image.height; // Padded height.
+    const int padding_width = (padded_width - width) / 2; // Padding width.
+    const int padding_height = (padded_height - height) / 2; // Padding height.
+
+    // Check if the padded image and the index tables match the image.
+    if (padded_image.channels != channels || padded_image.is_SoA != is_SoA || padding_width < 0 || padding_height < 0 ||
+        (int)column_table.size() != padded_width || (int)row_table.size() != padded_height || padded_image.buffer == buffer) {
+        std::cerr << "Error: Invalid padded image: (" << padded_width << ", " << padded_height << ")." << std::endl;
+        throw std::invalid_argument("Invalid padded image.");
+    }
+
+    const uint32_t all_channels = (channels >= 32) ? ALL_CHANNELS : ((1u << channels) - 1); // Mask of the image channels.
+    const uint32_t planes_mask = (is_SoA && (channel_mask & all_channels) != all_channels) ? (channel_mask & all_channels) : ALL_CHANNELS; // Padded planes (AoS pixels are padded whole).
+    const T* data = buffer->data; // Input image data.
+    T* padded_data = padded_image.get_data(); // Padded image data.
+
+    // The SoA image is padded plane by plane, while the AoS image is a single plane of interleaved pixels.
+    const int planes = is_SoA ? channels : 1; // Number of planes.
+    const int pixel_size = is_SoA ? 1 : channels; // Samples per pixel in a plane.
+    const size_t row_size = (size_t)width * pixel_size; // Samples per input row.
+    const size_t padded_row_size = (size_t)padded_width * pixel_size; // Samples per padded row.
+    const size_t plane_size = row_size * height; // Samples per input plane.
+    const size_t padded_plane_size = padded_row_size * padded_height; // Samples per padded plane.
+
+    // Copy the interior rows and fill their left and right borders, in bands of rows first touched by the threads that will convolve them.
+    const int band_rows = std::max(1, BAND_SIZE / (int)std::max((size_t)1, padded_row_size * planes * sizeof(T))); // Rows per band.
+    ThreadPool::get_instance().parallel_for(height, band_rows, [&](const int begin, const int end) {
+        for (int plane = 0; plane < planes; plane++) {
+            // Skip the planes not to be padded.
+            if (!is_channel_selected(planes_mask, plane)) { continue; }
+
+            for (int row = begin; row < end; row++) {
+                const T* input_row = data + plane * plane_size + row * row_size; // Input row.
+                T* padded_row = padded_data + plane * padded_plane_size + (row + padding_height) * padded_row_size; // Padded row.
+
+                // Copy the interior.
+                memcpy(padded_row + padding_width * pixel_size, input_row, row_size * sizeof(T));
+
+                // Fill the borders.
+                fill_border(padded_row, input_row, column_table, 0, padding_width, pixel_size, padding_type);
+                fill_border(padded_row, input_row, column_table, padding_width + width, padded_width, pixel_size, padding_type);
+            }
+        }
+    });
+
+    // Fill the top and bottom borders by copying the already padded source rows.
+    ThreadPool::get_instance().parallel_for(2 * padding_height, band_rows, [&](const int begin, const int end) {
+        for (int plane = 0; plane < planes; plane++) {
+            // Skip the planes not to be padded.
+            if (!is_channel_selected(planes_mask, plane)) { continue; }
+
+            T* padded_plane = padded_data + plane * padded_plane_size; // Padded plane.
+            for (int border_row = begin; border_row < end; border_row++) {
+                const int y = (border_row < padding_height) ? border_row : (height + border_row); // Padded row index.
+                if (row_table[y] < 0) {
+                    memset(padded_plane + y * padded_row_size, 0, padded_row_size * sizeof(T));
                 } else {
-                    if (padding_type == PaddingType::ZERO) {
-                        // Set the padded pixel to zero.
-                        padded_image(x, y, channel) = 0;
-                    } else if (padding_type == PaddingType::REPLICATE) {
-                        // Get the nearest valid pixel.
-                        const int valid_col = clamp(0, col, width - 1); // Column index of the nearest valid pixel.
-                        const int valid_row = clamp(0, row, height - 1); // Row index of the nearest valid pixel.
-
-                        // Set the padded pixel to the nearest valid pixel.
-                        padded_image(x, y, channel) = (*this)(valid_col, valid_row, channel);
-                    } else if (padding_type == PaddingType::MIRROR) {
-                        // Get the mirrored pixel.
-                        int mirror_col = std::abs(col % (2 * width)); // Column index of the mirrored pixel.
-                        int mirror_row = std::abs(row % (2 * height)); // Row index of the mirrored pixel.
-
-                        // Ensure that the mirrored pixel is in the valid range.
-                        mirror_col = std::min(mirror_col, ((2 * width) - 1) - (mirror_col + 1));
-                        mirror_row = std::min(mirror_row, ((2 * height) - 1) - (mirror_row + 1));
-
-                        // Set the padded pixel to the mirrored pixel.
-                        padded_image(x, y, channel) = (*this)(mirror_col, mirror_row, channel);
-                    }
+                    memcpy(padded_plane + y * padded_row_size, padded_plane + (row_table[y] + padding_height) * padded_row_size, padded_row_size * sizeof(T));
                 }
             }
         }
+    });
+}
+
+
+template <typename T>
+BasicImage<T> BasicImage<T>::get_channel(const int channel) const {
+    // Check if the channel is valid.
+    if (channel < 0 || channel >= channels) {
+        std::cerr << "Error: Invalid channel: " << channel << "." << std::endl;
+        throw std::invalid_argument("Invalid channel.");
     }
 
-    return padded_image;
+    // Create the single channel image (fully overwritten below, no need to zero it).
+    const size_t pixels = (size_t)width * height; // Number of pixels.
+    BasicImage channel_image(width, height, 1, is_SoA, allocate(pixels, false));
+    const T* data = buffer->data; // Input image data.
+    T* channel_data = channel_image.buffer->data; // Channel image data.
+
+    if (is_SoA) {
+        // Copy the channel plane.
+        memcpy(channel_data, data + channel * pixels, pixels * sizeof(T));
+    } else {
+        // Strided gather of the channel.
+        #pragma omp parallel for schedule(static) if(!ThreadPool::is_running_band())
+        for (long long pixel = 0; pixel < (long long)pixels; pixel++) {
+            channel_data[pixel] = data[pixel * channels + channel];
+        }
+    }
+
+    return channel_image;
 }
 
+// BT.601 luma of a color, with fixed point weights for 8 bits samples.
+static inline int luma_value(const uint8_t red, const uint8_t green, const uint8_t blue) {
+    return (77 * red + 150 * green + 29 * blue + 128) >> 8;
+}
 
-// Operators.
+template <typename T>
+static inline float luma_value(const T red, const T green, const T blue) {
+    return 0.299f * red + 0.587f * green + 0.114f * blue;
+}
 
-Image &Image::operator=(const Image &other) {
-    // Check if the images are different.
-    if (this != &other) {
-        // Get the size of the image.
-        size_t size = get_size();
+// Compute the luma of the pixels [begin, end) with BT.601 weights (pixels are STEP samples apart).
+template <int STEP, typename T>
+static void luma_pixels(const T* red, const T* green, const T* blue, T* luma, const size_t begin, const size_t end) {
+    for (size_t pixel = begin; pixel < end; pixel++) {
+        luma[pixel] = (T)luma_value(red[pixel * STEP], green[pixel * STEP], blue[pixel * STEP]);
+    }
+}
 
-        // Copy the image data.
-        memcpy(data, other.data, size * sizeof(uint8_t));
+// Shift the color samples of the pixels [begin, end) by the luma difference (pixels are STEP samples apart).
+template <int STEP, typename T>
+static void shift_luma_pixels(const T* red, const T* green, const T* blue, const T* new_luma,
+                              T* output_red, T* output_green, T* output_blue, const size_t begin, const size_t end) {
+    for (size_t pixel = begin; pixel < end; pixel++) {
+        const T r = red[pixel * STEP], g = green[pixel * STEP], b = blue[pixel * STEP]; // Input color.
+        const auto delta = new_luma[pixel] - luma_value(r, g, b); // Luma difference.
+
+        output_red[pixel * STEP] = SampleTraits<T>::saturate((float)(r + delta));
+        output_green[pixel * STEP] = SampleTraits<T>::saturate((float)(g + delta));
+        output_blue[pixel * STEP] = SampleTraits<T>::saturate((float)(b + delta));
+    }
+}
+
+template <typename T>
+void BasicImage<T>::copy_channel(const BasicImage& source, const int source_channel, const int channel) {
+    // Check if the source image is valid.
+    if (source.width != width || source.height != height || source.is_SoA != is_SoA || source_channel < 0 || source_channel >= source.channels || channel < 0 || channel >= channels) {
+        std::cerr << "Error: Invalid channel copy: (" << source_channel << " -> " << channel << ")." << std::endl;
+        throw std::invalid_argument("Invalid channel copy.");
     }
 
+    // Unshare the buffer (the source keeps the original one if they were shared).
+    detach();
+
+    const size_t pixels = (size_t)width * height; // Number of pixels.
+    const T* source_data = source.buffer->data; // Source image data.
+    T* data = buffer->data; // Image data.
+
+    if (is_SoA) {
+        // Contiguous plane copy.
+        memcpy(data + channel * pixels, source_data + source_channel * pixels, pixels * sizeof(T));
+    } else {
+        // Strided copy.
+        const int source_channels = source.channels; // Source image channels.
+        #pragma omp parallel for schedule(static) if(!ThreadPool::is_running_band())
+        for (long long pixel = 0; pixel < (long long)pixels; pixel++) {
+            data[pixel * channels + channel] = source_data[pixel * source_channels + source_channel];
+        }
+    }
+}
+
+template <typename T>
+BasicImage<T> BasicImage<T>::get_luma() const {
+    // Images without color channels are their own luma (gray, or gray and alpha).
+    if (channels == 1) {
+        return *this;
+    } else if (channels < 3) {
+        return get_channel(0);
+    }
+
+    // Create the luma image (fully overwritten below, no need to zero it).
+    const size_t pixels = (size_t)width * height; // Number of pixels.
+    BasicImage luma_image(width, height, 1, is_SoA, allocate(pixels, false));
+    const T* data = buffer->data; // Input image data.
+    T* luma = luma_image.buffer->data; // Luma image data.
+
+    // Color planes (interleaved samples in AoS architecture).
+    const size_t channel_offset = is_SoA ? pixels : 1; // Offset between the channels of a pixel.
+    const T* red = data; // Red samples.
+    const T* green = data + channel_offset; // Green samples.
+    const T* blue = data + 2 * channel_offset; // Blue samples.
+
+    // Split the image into bands of pixels.
+    const long long band_pixels = std::max(1, BAND_SIZE / channels); // Pixels per band.
+    const long long bands = ((long long)pixels + band_pixels - 1) / band_pixels; // Number of bands.
+
+    #pragma omp parallel for schedule(static) if(!ThreadPool::is_running_band())
+    for (long long band = 0; band < bands; band++) {
+        const size_t begin = band * band_pixels; // First pixel.
+        const size_t end = std::min((size_t)((band + 1) * band_pixels), pixels); // Last pixel (excluded).
+
+        if (is_SoA) {
+            luma_pixels<1>(red, green, blue, luma, begin, end);
+        } else if (channels == 3) {
+            luma_pixels<3>(red, green, blue, luma, begin, end);
+        } else if (channels == 4) {
+            luma_pixels<4>(red, green, blue, luma, begin, end);
+        } else {
+            for (size_t pixel = begin; pixel < end; pixel++) {
+                luma[pixel] = (T)luma_value(red[pixel * channels], green[pixel * channels], blue[pixel * channels]);
+            }
+        }
+    }
+
+    return luma_image;
+}
+
+template <typename T>
+BasicImage<T> BasicImage<T>::with_luma(const BasicImage& luma) const {
+    // Check if the luma image is valid.
+    if (luma.width != width || luma.height != height || luma.channels != 1) {
+        std::cerr << "Error: Invalid luma image dimensions: (" << luma.width << ", " << luma.height << ", " << luma.channels << ")." << std::endl;
+        throw std::invalid_argument("Invalid luma image dimensions.");
+    }
+
+    // Images without color channels are their own luma (gray, or gray and alpha: the alpha is kept).
+    if (channels == 1) {
+        return luma.converted(is_SoA);
+    } else if (channels < 3) {
+        BasicImage output_image = *this; // Output image (the buffer is unshared by the channel copy).
+        output_image.copy_channel(luma.converted(is_SoA), 0, 0);
+        return output_image;
+    }
+
+    // Create the output image starting from a copy of the input (to keep the samples beyond the color ones, e.g. alpha).
+    // Replacing the luma of a YCbCr pixel while keeping its chroma shifts R, G and B by the same luma difference,
+    // so the color transform and its inverse are fused into a single pass without materialising Cb and Cr.
+    const size_t pixels = (size_t)width * height; // Number of pixels.
+    BasicImage output_image(width, height, channels, is_SoA, allocate(get_size(), false));
+    memcpy(output_image.buffer->data, buffer->data, get_size() * sizeof(T));
+    output_image.is_grayscale = is_grayscale;
+
+    const T* data = buffer->data; // Input image data.
+    const T* new_luma = luma.buffer->data; // Luma image data.
+    T* output = output_image.buffer->data; // Output image data.
+
+    // Color planes (interleaved samples in AoS architecture).
+    const size_t channel_offset = is_SoA ? pixels : 1; // Offset between the channels of a pixel.
+
+    // Split the image into bands of pixels.
+    const long long band_pixels = std::max(1, BAND_SIZE / channels); // Pixels per band.
+    const long long bands = ((long long)pixels + band_pixels - 1) / band_pixels; // Number of bands.
+
+    #pragma omp parallel for schedule(static) if(!ThreadPool::is_running_band())
+    for (long long band = 0; band < bands; band++) {
+        const size_t begin = band * band_pixels; // First pixel.
+        const size_t end = std::min((size_t)((band + 1) * band_pixels), pixels); // Last pixel (excluded).
+
+        if (is_SoA) {
+            shift_luma_pixels<1>(data, data + channel_offset, data + 2 * channel_offset, new_luma, output, output + channel_offset, output + 2 * channel_offset, begin, end);
+        } else if (channels == 3) {
+            shift_luma_pixels<3>(data, data + 1, data + 2, new_luma, output, output + 1, output + 2, begin, end);
+        } else if (channels == 4) {
+            shift_luma_pixels<4>(data, data + 1, data + 2, new_luma, output, output + 1, output + 2, begin, end);
+        } else {
+            for (size_t pixel = begin; pixel < end; pixel++) {
+                const T* sample = data + pixel * channels; // Input pixel.
+                const auto delta = new_luma[pixel] - luma_value(sample[0], sample[1], sample[2]); // Luma difference.
+                for (int channel = 0; channel < 3; channel++) {
+                    output[pixel * channels + channel] = SampleTraits<T>::saturate((float)(sample[channel] + delta));
+                }
+            }
+        }
+    }
+
+    return output_image;
+}
+
+template <typename T>
+std::vector<int> BasicImage<T>::padding_table(const int size, const int padding, const PaddingType padding_type) {
+    std::vector<int> table(size + 2 * padding);
+
+    for (int i = 0; i < (int)table.size(); i++) {
+        // Index in the unpadded axis.
+        const int index = i - padding;
+
+        if (index >= 0 && index < size) {
+            // Interior index.
+            table[i] = index;
+        } else if (padding_type == PaddingType::ZERO) {
+            // Zero padding.
+            table[i] = -1;
+        } else if (padding_type == PaddingType::REPLICATE) {
+            // Nearest valid index.
+            table[i] = clamp(0, index, size - 1);
+        } else {
+            // Mirrored index (without repeating the edge).
+            int mirror_index = std::abs(index % (2 * size));
+            mirror_index = std::min(mirror_index, ((2 * size) - 1) - (mirror_index + 1));
+
+            // Ensure that the mirrored index is in the valid range (e.g. for single pixel axes).
+            table[i] = clamp(0, mirror_index, size - 1);
+        }
+    }
+
+    return table;
+}
+
+
+template <typename T>
+void BasicImage<T>::release_cache() const {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->converted.reset();
+    buffer->padded.clear();
+    buffer->has_cache = false;
+}
+
+
+// Operators.
+
+template <typename T>
+BasicImage<T>& BasicImage<T>::operator=(const BasicImage &other) {
+    // Share the pixel buffer of the other image.
+    width = other.width;
+    height = other.height;
+    channels = other.channels;
+    buffer = other.buffer;
+    is_SoA = other.is_SoA;
+    is_grayscale = other.is_grayscale;
+
     return *this;
 }
 
-uint8_t &Image::operator()(const int col, const int row, const int channel) const {
+template <typename T>
+const T &BasicImage<T>::operator()(const int col, const int row, const int channel) const {
     // Check if the coordinates are valid.
     if ((col < 0 || col >= width) || (row < 0 || row >= height) || (channel < 0 || channel >= channels)) {
         std::cerr << "Error: Invalid coordinates: (" << col << ", " << row << ", " << channel << ")." << std::endl;
@@ -236,10 +695,19 @@ uint8_t &Image::operator()(const int col, const int row, const int channel) cons
     // Get the 1D pixel index.
     const int pixel_index = is_SoA ? ((channel * width * height) + (row * width) + col) : ((row * width + col) * channels + channel);
 
-    return data[pixel_index];
+    return buffer->data[pixel_index];
+}
+
+template <typename T>
+T &BasicImage<T>::operator()(const int col, const int row, const int channel) {
+    // Unshare the buffer before handing out a mutable reference.
+    detach();
+
+    return const_cast<T&>(static_cast<const BasicImage&>(*this)(col, row, channel));
 }
 
-bool Image::operator==(const Image &other) const {
+template <typename T>
+bool BasicImage<T>::operator==(const BasicImage &other) const {
     // Check if the images have the same dimensions.
     if (width != other.width || height != other.height || channels != other.channels) {
         return false;
@@ -249,10 +717,11 @@ bool Image::operator==(const Image &other) const {
     size_t size = get_size();
 
     // Compare the image data.
-    return memcmp(data, other.data, size * sizeof(uint8_t)) == 0;
+    return buffer == other.buffer || memcmp(buffer->data, other.buffer->data, size * sizeof(T)) == 0;
 }
 
-std::ostream &operator<<(std::ostream &os, const Image &image) {
+template <typename T>
+std::ostream &operator<<(std::ostream &os, const BasicImage<T> &image) {
     // Calculate the maximum element width.
     std::string str;
     int maxElementWidth = 1;
@@ -270,7 +739,7 @@ std::ostream &operator<<(std::ostream &os, const Image &image) {
         for (int col = 0; col < image.get_width(); col++) {
             os << "(";
             for (int channel = 0; channel < image.get_channels(); channel++) {
-                os << std::setw(maxElementWidth) << (int)image(col, row, channel);
+                os << std::setw(maxElementWidth) << +image(col, row, channel);
                 if (channel < image.get_channels() - 1) {
                     os << ", ";
                 }
@@ -287,46 +756,423 @@ std::ostream &operator<<(std::ostream &os, const Image &image) {
 }
 
 
-// Private methods.
+// Padding.
 
-void Image::AoS_to_SoA() {
-    // Get the size of the image.
-    size_t size = get_size();
+// Gather samples of a row through an index table.
+template <typename T>
+static ISA_INLINE void gather_samples_body(const T* input, const int* table, T* output, const int count) {
+    #pragma omp simd
+    for (int x = 0; x < count; x++) { output[x] = input[table[x]]; }
+}
 
-    // Allocate memory for the image in SoA architecture.
-    uint8_t* data_SoA = new uint8_t[size]{0};
+#if ISA_DISPATCH
+template <typename T>
+static ISA_TARGET_SSE4_2 void gather_samples_sse4_2(const T* input, const int* table, T* output, const int count) { gather_samples_body(input, table, output, count); }
+
+template <typename T>
+static ISA_TARGET_AVX2 void gather_samples_avx2(const T* input, const int* table, T* output, const int count) { gather_samples_body(input, table, output, count); }
+
+template <typename T>
+static ISA_TARGET_AVX512 void gather_samples_avx512(const T* input, const int* table, T* output, const int count) { gather_samples_body(input, table, output, count); }
+#endif
+
+// Gather samples with the variant of the active instruction set.
+template <typename T>
+static void gather_samples(const T* input, const int* table, T* output, const int count) {
+    switch (Isa::get_instruction_set()) {
+#if ISA_DISPATCH
+        case InstructionSet::AVX512: gather_samples_avx512(input, table, output, count); break;
+        case InstructionSet::AVX2: gather_samples_avx2(input, table, output, count); break;
+        case InstructionSet::SSE4_2: gather_samples_sse4_2(input, table, output, count); break;
+#endif
+        default: gather_samples_body(input, table, output, count);
+    }
+}
 
-    // Copy the image data in SoA architecture.
-    for (int channel = 0; channel < channels; channel++) {
-        for (int row = 0; row < height; row++) {
-            for (int col = 0; col < width; col++) {                
-                data_SoA[channel * width * height + row * width + col] = data[(row * width + col) * channels + channel];
+template <typename T>
+void BasicImage<T>::fill_border(T* padded_row, const T* input_row, const std::vector<int>& column_table, const int begin, const int end, const int pixel_size, const PaddingType padding_type) {
+    // Nothing to fill.
+    if (begin >= end) { return; }
+
+    T* border = padded_row + begin * pixel_size; // First border sample.
+    const size_t border_size = (size_t)(end - begin) * pixel_size; // Samples in the border.
+
+    if (padding_type == PaddingType::ZERO) {
+        // Zero fill.
+        memset(border, 0, border_size * sizeof(T));
+    } else if (padding_type == PaddingType::REPLICATE) {
+        // All the border pixels replicate the same edge pixel.
+        const T* edge_pixel = input_row + column_table[begin] * pixel_size;
+        if (pixel_size == 1) {
+            std::fill(border, border + border_size, edge_pixel[0]);
+        } else {
+            // Copy the pixel once, then double the filled region at every step.
+            memcpy(border, edge_pixel, pixel_size * sizeof(T));
+            for (size_t filled = pixel_size; filled < border_size; filled *= 2) {
+                memcpy(border + filled, border, std::min(filled, border_size - filled) * sizeof(T));
             }
         }
+    } else if (pixel_size == 1) {
+        // Mirrored gather of single samples.
+        gather_samples(input_row, column_table.data() + begin, padded_row + begin, end - begin);
+    } else {
+        // Mirrored gather of whole pixels.
+        for (int x = begin; x < end; x++) {
+            memcpy(padded_row + x * pixel_size, input_row + column_table[x] * pixel_size, pixel_size * sizeof(T));
+        }
+    }
+}
+
+
+template <typename T>
+bool BasicImage<T>::detect_grayscale(const T* data, const size_t pixels, const int channels) {
+    size_t pixel = 0;
+
+#if defined(__SSE2__)
+    // Bit i of mask[reg] is set if byte i of register reg (in a block of 16 pixels) is a red or green sample.
+    uint32_t mask[16] = {0};
+    for (int reg = 0; reg < channels && channels <= 16; reg++) {
+        for (int i = 0; i < 16; i++) {
+            const int channel = (reg * 16 + i) % channels;
+            if (channel == 0 || channel == 1) { mask[reg] |= (1u << i); }
+        }
     }
 
-    // Update the existing data array.
-    delete[] data;
-    data = data_SoA; 
+    // Compare every red (green) sample with the following green (blue) sample, 16 pixels at a time.
+    // The last block is left to the scalar loop since it reads one byte past the block (8 bits samples only).
+    for (; sizeof(T) == 1 && channels <= 16 && pixel + 16 < pixels; pixel += 16) {
+        const T* block = data + pixel * channels; // First byte of the block.
+        for (int reg = 0; reg < channels; reg++) {
+            const __m128i current = _mm_loadu_si128((const __m128i*)(block + reg * 16));
+            const __m128i next = _mm_loadu_si128((const __m128i*)(block + reg * 16 + 1));
+            const uint32_t equal = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(current, next));
+            if ((equal & mask[reg]) != mask[reg]) { return false; }
+        }
+    }
+#endif
+
+    // Scalar tail.
+    for (; pixel < pixels; pixel++) {
+        const T* sample = data + pixel * channels; // First sample of the pixel.
+        if (sample[0] != sample[1] || sample[1] != sample[2]) { return false; }
+    }
+
+    return true;
 }
 
-void Image::SoA_to_AoS() {
-    // Get the size of the image.
-    size_t size = get_size();
 
-    // Allocate memory for the image in AoS architecture.
-    uint8_t* data_AoS = new uint8_t[size]{0};
+// Layout conversion.
+
+// Shuffle masks to (de)interleave 16 pixels with C channels held in C 128-bit registers.
+template <int C>
+struct ShuffleMasks {
+    alignas(16) uint8_t deinterleave[C][C][16]; // [Output channel][Input register][Byte].
+    alignas(16) uint8_t interleave[C][C][16]; // [Output register][Input channel][Byte].
+
+    ShuffleMasks() {
+        for (int channel = 0; channel < C; channel++) {
+            for (int reg = 0; reg < C; reg++) {
+                for (int i = 0; i < 16; i++) {
+                    // Byte i of the channel plane is byte (i * C + channel) of the interleaved block.
+                    const int aos_index = i * C + channel;
+                    deinterleave[channel][reg][i] = (aos_index / 16 == reg) ? (aos_index % 16) : 0x80;
+
+                    // Byte i of interleaved register reg holds pixel (reg * 16 + i) / C of channel (reg * 16 + i) % C.
+                    const int block_index = reg * 16 + i;
+                    interleave[reg][channel][i] = (block_index % C == channel) ? (block_index / C) : 0x80;
+                }
+            }
+        }
+    }
+};
+
+// Deinterleave the pixels [begin, end) of an AoS buffer with C channels into C planes.
+template <int C, typename T>
+static ISA_INLINE void deinterleave_pixels_body(const T* input, T* output, const size_t plane_size, size_t begin, const size_t end) {
+    for (; begin < end; begin++) {
+        for (int channel = 0; channel < C; channel++) {
+            output[channel * plane_size + begin] = input[begin * C + channel];
+        }
+    }
+}
+
+// Interleave the pixels [begin, end) of C planes into an AoS buffer with C channels.
+template <int C, typename T>
+static ISA_INLINE void interleave_pixels_body(const T* input, T* output, const size_t plane_size, size_t begin, const size_t end) {
+    for (; begin < end; begin++) {
+        for (int channel = 0; channel < C; channel++) {
+            output[begin * C + channel] = input[channel * plane_size + begin];
+        }
+    }
+}
+
+#if ISA_DISPATCH
+// The 8 bits samples are shuffled by blocks of 16 pixels, one per 128-bit lane (the AVX2 and AVX-512 variants shuffle 2 and 4
+// consecutive blocks at once), the other ones and the tail by the body.
+
+template <int C, typename T>
+static ISA_TARGET_SSE4_2 void deinterleave_pixels_sse4_2(const T* input, T* output, const size_t plane_size, size_t begin, const size_t end) {
+    static const ShuffleMasks<C> masks;
+
+    for (; sizeof(T) == 1 && begin + 16 <= end; begin += 16) {
+        __m128i in[C];
+        for (int reg = 0; reg < C; reg++) {
+            in[reg] = _mm_loadu_si128((const __m128i*)(input + begin * C + reg * 16));
+        }
+
+        for (int channel = 0; channel < C; channel++) {
+            __m128i plane = _mm_shuffle_epi8(in[0], _mm_load_si128((const __m128i*)masks.deinterleave[channel][0]));
+            for (int reg = 1; reg < C; reg++) {
+                plane = _mm_or_si128(plane, _mm_shuffle_epi8(in[reg], _mm_load_si128((const __m128i*)masks.deinterleave[channel][reg])));
+            }
+            _mm_storeu_si128((__m128i*)(output + channel * plane_size + begin), plane);
+        }
+    }
+
+    deinterleave_pixels_body<C>(input, output, plane_size, begin, end);
+}
+
+template <int C, typename T>
+static ISA_TARGET_SSE4_2 void interleave_pixels_sse4_2(const T* input, T* output, const size_t plane_size, size_t begin, const size_t end) {
+    static const ShuffleMasks<C> masks;
+
+    for (; sizeof(T) == 1 && begin + 16 <= end; begin += 16) {
+        __m128i in[C];
+        for (int channel = 0; channel < C; channel++) {
+            in[channel] = _mm_loadu_si128((const __m128i*)(input + channel * plane_size + begin));
+        }
+
+        for (int reg = 0; reg < C; reg++) {
+            __m128i block = _mm_shuffle_epi8(in[0], _mm_load_si128((const __m128i*)masks.interleave[reg][0]));
+            for (int channel = 1; channel < C; channel++) {
+                block = _mm_or_si128(block, _mm_shuffle_epi8(in[channel], _mm_load_si128((const __m128i*)masks.interleave[reg][channel])));
+            }
+            _mm_storeu_si128((__m128i*)(output + begin * C + reg * 16), block);
+        }
+    }
+
+    interleave_pixels_body<C>(input, output, plane_size, begin, end);
+}
+
+template <int C, typename T>
+static ISA_TARGET_AVX2 void deinterleave_pixels_avx2(const T* input, T* output, const size_t plane_size, size_t begin, const size_t end) {
+    static const ShuffleMasks<C> masks;
+
+    for (; sizeof(T) == 1 && begin + 32 <= end; begin += 32) {
+        // Register reg of the first block in the low lane, of the second block in the high lane.
+        __m256i in[C];
+        for (int reg = 0; reg < C; reg++) {
+            const __m128i low = _mm_loadu_si128((const __m128i*)(input + begin * C + reg * 16));
+            const __m128i high = _mm_loadu_si128((const __m128i*)(input + (begin + 16) * C + reg * 16));
+            in[reg] = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        }
+
+        for (int channel = 0; channel < C; channel++) {
+            __m256i plane = _mm256_shuffle_epi8(in[0], _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)masks.deinterleave[channel][0])));
+            for (int reg = 1; reg < C; reg++) {
+                plane = _mm256_or_si256(plane, _mm256_shuffle_epi8(in[reg], _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)masks.deinterleave[channel][reg]))));
+            }
+            _mm256_storeu_si256((__m256i*)(output + channel * plane_size + begin), plane);
+        }
+    }
+
+    deinterleave_pixels_body<C>(input, output, plane_size, begin, end);
+}
+
+template <int C, typename T>
+static ISA_TARGET_AVX2 void interleave_pixels_avx2(const T* input, T* output, const size_t plane_size, size_t begin, const size_t end) {
+    static const ShuffleMasks<C> masks;
+
+    for (; sizeof(T) == 1 && begin + 32 <= end; begin += 32) {
+        __m256i in[C];
+        for (int channel = 0; channel < C; channel++) {
+            in[channel] = _mm256_loadu_si256((const __m256i*)(input + channel * plane_size + begin));
+        }
+
+        // Register reg of the first block is in the low lane, of the second block in the high lane.
+        for (int reg = 0; reg < C; reg++) {
+            __m256i block = _mm256_shuffle_epi8(in[0], _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)masks.interleave[reg][0])));
+            for (int channel = 1; channel < C; channel++) {
+                block = _mm256_or_si256(block, _mm256_shuffle_epi8(in[channel], _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)masks.interleave[reg][channel]))));
+            }
+            _mm_storeu_si128((__m128i*)(output + begin * C + reg * 16), _mm256_castsi256_si128(block));
+            _mm_storeu_si128((__m128i*)(output + (begin + 16) * C + reg * 16), _mm256_extracti128_si256(block, 1));
+        }
+    }
+
+    interleave_pixels_body<C>(input, output, plane_size, begin, end);
+}
+
+template <int C, typename T>
+static ISA_TARGET_AVX512 void deinterleave_pixels_avx512(const T* input, T* output, const size_t plane_size, size_t begin, const size_t end) {
+    static const ShuffleMasks<C> masks;
+
+    for (; sizeof(T) == 1 && begin + 64 <= end; begin += 64) {
+        // Register reg of the block b in lane b.
+        __m512i in[C];
+        for (int reg = 0; reg < C; reg++) {
+            const T* block = input + begin * C + reg * 16; // Register of the first block.
+            __m512i lanes = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*)block));
+            lanes = _mm512_inserti32x4(lanes, _mm_loadu_si128((const __m128i*)(block + 16 * C)), 1);
+            lanes = _mm512_inserti32x4(lanes, _mm_loadu_si128((const __m128i*)(block + 32 * C)), 2);
+            in[reg] = _mm512_inserti32x4(lanes, _mm_loadu_si128((const __m128i*)(block + 48 * C)), 3);
+        }
+
+        for (int channel = 0; channel < C; channel++) {
+            __m512i plane = _mm512_shuffle_epi8(in[0], _mm512_broadcast_i32x4(_mm_load_si128((const __m128i*)masks.deinterleave[channel][0])));
+            for (int reg = 1; reg < C; reg++) {
+                plane = _mm512_or_si512(plane, _mm512_shuffle_epi8(in[reg], _mm512_broadcast_i32x4(_mm_load_si128((const __m128i*)masks.deinterleave[channel][reg]))));
+            }
+            _mm512_storeu_si512((void*)(output + channel * plane_size + begin), plane);
+        }
+    }
+
+    deinterleave_pixels_body<C>(input, output, plane_size, begin, end);
+}
+
+template <int C, typename T>
+static ISA_TARGET_AVX512 void interleave_pixels_avx512(const T* input, T* output, const size_t plane_size, size_t begin, const size_t end) {
+    static const ShuffleMasks<C> masks;
+
+    for (; sizeof(T) == 1 && begin + 64 <= end; begin += 64) {
+        __m512i in[C];
+        for (int channel = 0; channel < C; channel++) {
+            in[channel] = _mm512_loadu_si512((const void*)(input + channel * plane_size + begin));
+        }
+
+        // Register reg of the block b is in lane b.
+        for (int reg = 0; reg < C; reg++) {
+            __m512i lanes = _mm512_shuffle_epi8(in[0], _mm512_broadcast_i32x4(_mm_load_si128((const __m128i*)masks.interleave[reg][0])));
+            for (int channel = 1; channel < C; channel++) {
+                lanes = _mm512_or_si512(lanes, _mm512_shuffle_epi8(in[channel], _mm512_broadcast_i32x4(_mm_load_si128((const __m128i*)masks.interleave[reg][channel]))));
+            }
+            T* block = output + begin * C + reg * 16; // Register of the first block.
+            _mm_storeu_si128((__m128i*)block, _mm512_castsi512_si128(lanes));
+            _mm_storeu_si128((__m128i*)(block + 16 * C), _mm512_extracti32x4_epi32(lanes, 1));
+            _mm_storeu_si128((__m128i*)(block + 32 * C), _mm512_extracti32x4_epi32(lanes, 2));
+            _mm_storeu_si128((__m128i*)(block + 48 * C), _mm512_extracti32x4_epi32(lanes, 3));
+        }
+    }
+
+    interleave_pixels_body<C>(input, output, plane_size, begin, end);
+}
+#endif
+
+// (De)interleave the pixels with the variant of the active instruction set.
+template <int C, typename T>
+static void deinterleave_pixels(const T* input, T* output, const size_t plane_size, const size_t begin, const size_t end) {
+    switch (Isa::get_instruction_set()) {
+#if ISA_DISPATCH
+        case InstructionSet::AVX512: deinterleave_pixels_avx512<C>(input, output, plane_size, begin, end); break;
+        case InstructionSet::AVX2: deinterleave_pixels_avx2<C>(input, output, plane_size, begin, end); break;
+        case InstructionSet::SSE4_2: deinterleave_pixels_sse4_2<C>(input, output, plane_size, begin, end); break;
+#endif
+        default: deinterleave_pixels_body<C>(input, output, plane_size, begin, end);
+    }
+}
+
+template <int C, typename T>
+static void interleave_pixels(const T* input, T* output, const size_t plane_size, const size_t begin, const size_t end) {
+    switch (Isa::get_instruction_set()) {
+#if ISA_DISPATCH
+        case InstructionSet::AVX512: interleave_pixels_avx512<C>(input, output, plane_size, begin, end); break;
+        case InstructionSet::AVX2: interleave_pixels_avx2<C>(input, output, plane_size, begin, end); break;
+        case InstructionSet::SSE4_2: interleave_pixels_sse4_2<C>(input, output, plane_size, begin, end); break;
+#endif
+        default: interleave_pixels_body<C>(input, output, plane_size, begin, end);
+    }
+}
+
+// Convert between AoS and SoA architectures over row bands processed in parallel.
+template <typename T>
+static void convert_layout(const T* input, T* output, const int width, const int height, const int channels, const bool to_SoA) {
+    // Single channel images have the same layout in both architectures.
+    if (channels == 1) {
+        memcpy(output, input, (size_t)width * height * sizeof(T));
+        return;
+    }
 
-    // Copy the image data in AoS architecture.
-    for (int channel = 0; channel < channels; channel++) {
-        for (int row = 0; row < height; row++) {
-            for (int col = 0; col < width; col++) {                
-                data_AoS[(row * width + col) * channels + channel] = data[channel * width * height + row * width + col];
+    // Split the image into bands of rows.
+    const size_t plane_size = (size_t)width * height; // Number of pixels per channel.
+    const int band_rows = std::max(1, BAND_SIZE / std::max(1, width * channels * (int)sizeof(T))); // Rows per band.
+    const int bands = (height + band_rows - 1) / band_rows; // Number of bands.
+
+    // Inside a band of the thread pool (e.g. a batch of small images), the other threads are already busy.
+    #pragma omp parallel for schedule(static) if(!ThreadPool::is_running_band())
+    for (int band = 0; band < bands; band++) {
+        // Pixel range of the band.
+        const size_t begin = (size_t)band * band_rows * width; // First pixel.
+        const size_t end = std::min((size_t)(band + 1) * band_rows, (size_t)height) * width; // Last pixel (excluded).
+
+        if (channels == 2) {
+            to_SoA ? deinterleave_pixels<2>(input, output, plane_size, begin, end) : interleave_pixels<2>(input, output, plane_size, begin, end);
+        } else if (channels == 3) {
+            to_SoA ? deinterleave_pixels<3>(input, output, plane_size, begin, end) : interleave_pixels<3>(input, output, plane_size, begin, end);
+        } else if (channels == 4) {
+            to_SoA ? deinterleave_pixels<4>(input, output, plane_size, begin, end) : interleave_pixels<4>(input, output, plane_size, begin, end);
+        } else {
+            // Generic channel count.
+            for (size_t pixel = begin; pixel < end; pixel++) {
+                for (int channel = 0; channel < channels; channel++) {
+                    if (to_SoA) {
+                        output[channel * plane_size + pixel] = input[pixel * channels + channel];
+                    } else {
+                        output[pixel * channels + channel] = input[channel * plane_size + pixel];
+                    }
+                }
             }
         }
     }
+}
+
+template <typename T>
+void BasicImage<T>::AoS_to_SoA(const T* input, T* output, const int width, const int height, const int channels) {
+    convert_layout(input, output, width, height, channels, true);
+}
+
+template <typename T>
+void BasicImage<T>::SoA_to_AoS(const T* input, T* output, const int width, const int height, const int channels) {
+    convert_layout(input, output, width, height, channels, false);
+}
+
+
+// Private methods.
+
+template <typename T>
+std::shared_ptr<typename BasicImage<T>::Buffer> BasicImage<T>::allocate(const size_t size, const bool zero) {
+    std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>();
+    buffer->data = zero ? new T[size]{0} : new T[size];
+
+    return buffer;
+}
+
+template <typename T>
+void BasicImage<T>::detach() {
+    if (!buffer) { return; }
+
+    // The pixels may no longer have identical color channels after the mutation.
+    is_grayscale = false;
+
+    if (buffer.use_count() > 1) {
+        // Shared buffer: copy it before it is mutated.
+        std::shared_ptr<Buffer> copy = allocate(get_size(), false);
+        memcpy(copy->data, buffer->data, get_size() * sizeof(T));
+        buffer = copy;
+    } else if (buffer->has_cache) {
+        // Exclusive buffer: the cached derived images become stale.
+        release_cache();
+    }
+}
+
+
+// Sample types.
+
+template class BasicImage<uint8_t>;
+template class BasicImage<uint16_t>;
+template class BasicImage<int16_t>;
+template class BasicImage<float>;
 
-    // Update the existing data array.
-    delete[] data;
-    data = data_AoS;
-}
\ No newline at end of file
+template std::ostream& operator<<(std::ostream& os, const BasicImage<uint8_t>& image);
+template std::ostream& operator<<(std::ostream& os, const BasicImage<uint16_t>& image);
+template std::ostream& operator<<(std::ostream& os, const BasicImage<int16_t>& image);
+template std::ostream& operator<<(std::ostream& os, const BasicImage<float>& image);
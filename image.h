@@ -3,7 +3,10 @@
 
 #include <stdint.h>
 #include <cstdio>
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
+#include <memory>
 
 
 // Image types.
@@ -13,6 +16,7 @@ enum ImageType {
     JPEG,
     BMP,
     TGA,
+    HDR,
     UNKNOWN
 };
 
@@ -25,7 +29,65 @@ enum PaddingType {
 };
 
 
-class Image {
+// Channel mask selecting every channel (bit c selects channel c).
+const uint32_t ALL_CHANNELS = 0xFFFFFFFF;
+
+/*
+    * Check whether a channel is selected by a channel mask (channels beyond the mask width are always selected).
+    *
+    * @param channel_mask The channel mask.
+    * @param channel The channel.
+    * 
+    * @return True if the channel is selected, false otherwise.
+*/
+inline bool is_channel_selected(const uint32_t channel_mask, const int channel) {
+    return channel >= 32 || ((channel_mask >> channel) & 1);
+}
+
+
+// Range of the sample types of the images and their conversion from the float convolution values.
+template <typename T>
+struct SampleTraits;
+
+template <>
+struct SampleTraits<uint8_t> {
+    // Range of the samples (values beyond it are saturated).
+    static constexpr float min = 0.0f, max = 255.0f;
+
+    // Convert a sample to 8 bits (e.g. to save it).
+    static uint8_t to_uint8(const uint8_t sample) { return sample; }
+
+    // Convert a value to a sample, truncated and saturated to the sample range.
+    static uint8_t saturate(const float value) { return (uint8_t)(value < min ? min : (value > max ? max : value)); }
+};
+
+template <>
+struct SampleTraits<uint16_t> {
+    static constexpr float min = 0.0f, max = 65535.0f;
+    static uint8_t to_uint8(const uint16_t sample) { return (uint8_t)((sample + 128) / 257); }
+    static uint16_t saturate(const float value) { return (uint16_t)(value < min ? min : (value > max ? max : value)); }
+};
+
+// Signed samples hold the responses of 8 bits images to derivative kernels, such as edge detection.
+template <>
+struct SampleTraits<int16_t> {
+    static constexpr float min = -32768.0f, max = 32767.0f;
+    static uint8_t to_uint8(const int16_t sample) { return (uint8_t)std::min(std::max((int)sample, 0), 255); }
+    static int16_t saturate(const float value) { return (int16_t)(value < min ? min : (value > max ? max : value)); }
+};
+
+// Float samples are linear, nominally in [0, 1] (HDR samples exceed it), and never saturated.
+template <>
+struct SampleTraits<float> {
+    static constexpr float min = 0.0f, max = 1.0f;
+    static uint8_t to_uint8(const float sample) { return (uint8_t)std::min(std::max(sample * 255.0f + 0.5f, 0.0f), 255.0f); }
+    static float saturate(const float value) { return value; }
+};
+
+
+// Image with samples of type T (uint8_t, uint16_t, int16_t or float).
+template <typename T>
+class BasicImage {
     public:
         // Constructors and destructor.
 
@@ -36,7 +98,7 @@ class Image {
             * @param channel_force The number of channels to force the image to have (default: 0).
             * @param is_SoA Whether the image is in SoA architecture (default: false).
         */
-        Image(const char* filename, const int channel_force = 0, const bool is_SoA = false);
+        BasicImage(const char* filename, const int channel_force = 0, const bool is_SoA = false);
 
         /*
             * Create an empty image with the given dimensions.
@@ -46,7 +108,7 @@ class Image {
             * @param channels The number of channels of the image.
             * @param is_SoA Whether the image is in SoA architecture (default: false).
         */
-        Image(const int width, const int height, const int channels, const bool is_SoA = false);
+        BasicImage(const int width, const int height, const int channels, const bool is_SoA = false);
 
         /*
             * Create an image with the given dimensions and data.
@@ -57,19 +119,32 @@ class Image {
             * @param data The data to fill the image with.
             * @param is_SoA Whether the image is in SoA architecture (default: false).
         */
-        Image(const int width, const int height, const int channels, uint8_t* data, const bool is_SoA = false);
+        BasicImage(const int width, const int height, const int channels, const T* data, const bool is_SoA = false);
         
         /*
-            * Copy constructor for an image.
+            * Copy constructor for an image (the pixel buffer is shared until one of the copies is mutated).
             *
             * @param image The image to be copied.
         */
-        Image(const Image& image);
+        BasicImage(const BasicImage& image);
 
         /*
             * Destructor.
         */
-        ~Image();
+        ~BasicImage();
+
+        /*
+            * Create an image with the given dimensions whose data is left uninitialized, to be fully overwritten
+            * (its memory pages are first touched, hence placed, by the threads writing them).
+            *
+            * @param width The width of the image.
+            * @param height The height of the image.
+            * @param channels The number of channels of the image.
+            * @param is_SoA Whether the image is in SoA architecture (default: false).
+            *
+            * @return The uninitialized image.
+        */
+        static BasicImage uninitialized(const int width, const int height, const int channels, const bool is_SoA = false);
 
 
         // Getters.
@@ -103,11 +178,18 @@ class Image {
         size_t get_size() const;
         
         /*
-            * Get the linearized data of the image.
+            * Get the linearized data of the image for reading.
             *
             * @return The linearized data of the image.
         */
-        uint8_t* get_data() const;
+        const T* get_data() const;
+
+        /*
+            * Get the linearized data of the image for writing (the buffer is unshared first).
+            *
+            * @return The linearized data of the image.
+        */
+        T* get_data();
 
         /*
             * Get architecture of the image.
@@ -116,6 +198,13 @@ class Image {
         */
         bool get_is_SoA() const;
 
+        /*
+            * Get whether the color channels of the image are identical (detected at load time).
+            *
+            * @return True if the image has at least 3 channels and R == G == B for every pixel, false otherwise.
+        */
+        bool get_is_grayscale() const;
+
         /*
             * Get the type of an image from its filename.
             *
@@ -139,36 +228,132 @@ class Image {
         bool load_image(const char* filename, const int channel_force = 0);
 
         /*
-            * Save an image to a filename path.
+            * Save an image to a filename path (the image architecture is left unchanged).
             *
             * @param filename The path of the image to be saved.
         */
-        void save_image(const char* filename);
+        void save_image(const char* filename) const;
+
+        /*
+            * Convert the image data to the given architecture in place.
+            *
+            * @param is_SoA Whether the image must be in SoA architecture.
+        */
+        void set_is_SoA(const bool is_SoA);
+
+        /*
+            * Get the image in the given architecture (the conversion is cached on the shared buffer).
+            *
+            * @param is_SoA Whether the image must be in SoA architecture.
+            * 
+            * @return The image in the given architecture, sharing the pixel buffer of the cached conversion.
+        */
+        BasicImage converted(const bool is_SoA) const;
+
+        /*
+            * Copy the image data into a caller buffer in the given architecture, without reallocating.
+            *
+            * @param buffer The destination buffer (at least get_size() samples).
+            * @param is_SoA Whether the buffer must be in SoA architecture.
+        */
+        void copy_data(T* buffer, const bool is_SoA) const;
 
         /*
-            * Applies padding to the image.
+            * Applies padding to the image (the padded image is cached on the shared buffer).
             *
-            * @param image The image to be padded.
             * @param padding_width The padding width.
             * @param padding_height The padding height.
             * @param padding_type The padding type.
+            * @param channel_mask The channels to be padded (the other planes of SoA images are left uninitialized).
             * 
             * @return The padded image.
         */
-        Image padding(const int padding_width, const int padding_height, const PaddingType padding_type) const;
+        BasicImage padding(const int padding_width, const int padding_height, const PaddingType padding_type, const uint32_t channel_mask = ALL_CHANNELS) const;
+
+        /*
+            * Pad the image into a preallocated image (e.g. scratch memory reused across frames), without caching it.
+            *
+            * @param padded_image The padded image, with the same channels and architecture as the image.
+            * @param column_table The source column of every padded column (see padding_table).
+            * @param row_table The source row of every padded row (see padding_table).
+            * @param padding_type The padding type.
+            * @param channel_mask The channels to be padded (SoA only, the other planes are left untouched).
+        */
+        void padding_into(BasicImage& padded_image, const std::vector<int>& column_table, const std::vector<int>& row_table, const PaddingType padding_type, const uint32_t channel_mask = ALL_CHANNELS) const;
+
+        /*
+            * Extract a single channel of the image.
+            *
+            * @param channel The channel to be extracted.
+            * 
+            * @return The single channel image.
+        */
+        BasicImage get_channel(const int channel) const;
+
+        /*
+            * Copy a channel of another image with the same dimensions and architecture into a channel of this image.
+            *
+            * @param source The source image.
+            * @param source_channel The channel of the source image.
+            * @param channel The channel of this image to be overwritten.
+        */
+        void copy_channel(const BasicImage& source, const int source_channel, const int channel);
+
+        /*
+            * Compute the luma (Y of YCbCr, BT.601) of the image.
+            *
+            * @return The single channel luma image (the gray channel of images with less than 3 channels).
+        */
+        BasicImage get_luma() const;
+
+        /*
+            * Replace the luma of the image, keeping its chroma (Cb, Cr) and alpha.
+            *
+            * @param luma The single channel luma image.
+            * 
+            * @return The image with the given luma.
+        */
+        BasicImage with_luma(const BasicImage& luma) const;
+
+        /*
+            * Compute the source index of every padded position along one axis.
+            *
+            * @param size The size of the unpadded axis.
+            * @param padding The padding applied on each side of the axis.
+            * @param padding_type The padding type.
+            * 
+            * @return The source index of each of the (size + 2 * padding) positions (-1 for zero padding).
+        */
+        static std::vector<int> padding_table(const int size, const int padding, const PaddingType padding_type);
+
+        /*
+            * Release the layout conversions and padded images cached on the shared buffer.
+        */
+        void release_cache() const;
 
 
         // Operators.
 
         /*
-            * Assignment operator for an image.
+            * Assignment operator for an image (the pixel buffer is shared until one of the images is mutated).
             *
             * @param other The image to be assigned.
         */
-        Image& operator=(const Image& other);
+        BasicImage& operator=(const BasicImage& other);
+
+        /*
+            * Get the image pixel value at the given position for reading.
+            *
+            * @param col The column of the image pixel.
+            * @param row The row of the image pixel.
+            * @param channel The channel of the image pixel.
+            * 
+            * @return The image pixel value at the given position.
+        */
+        const T& operator()(const int col, const int row, const int channel) const;
 
         /*
-            * Get the image pixel value at the given position.
+            * Get the image pixel value at the given position for writing (the buffer is unshared first).
             *
             * @param col The column of the image pixel.
             * @param row The row of the image pixel.
@@ -176,7 +361,7 @@ class Image {
             * 
             * @return The image pixel value at the given position.
         */
-        uint8_t& operator()(const int col, const int row, const int channel) const;
+        T& operator()(const int col, const int row, const int channel);
 
         /*
             * Compare two images.
@@ -185,12 +370,38 @@ class Image {
             * 
             * @return True if the images are equal, false otherwise.
         */
-        bool operator==(const Image& other) const;
+        bool operator==(const BasicImage& other) const;
 
         /*
             * Print the image.
         */
-        friend std::ostream& operator<<(std::ostream& os, const Image& image);
+        template <typename U>
+        friend std::ostream& operator<<(std::ostream& os, const BasicImage<U>& image);
+
+
+        // Layout conversion.
+
+        /*
+            * Deinterleave AoS data into SoA data (vectorised and multi-threaded over row bands).
+            *
+            * @param input The input data in AoS architecture.
+            * @param output The output buffer in SoA architecture (must not alias the input).
+            * @param width The width of the image.
+            * @param height The height of the image.
+            * @param channels The number of channels of the image.
+        */
+        static void AoS_to_SoA(const T* input, T* output, const int width, const int height, const int channels);
+
+        /*
+            * Interleave SoA data into AoS data (vectorised and multi-threaded over row bands).
+            *
+            * @param input The input data in SoA architecture.
+            * @param output The output buffer in AoS architecture (must not alias the input).
+            * @param width The width of the image.
+            * @param height The height of the image.
+            * @param channels The number of channels of the image.
+        */
+        static void SoA_to_AoS(const T* input, T* output, const int width, const int height, const int channels);
 
         
     private:
@@ -199,24 +410,75 @@ class Image {
         // Image dimensions.
         int width = 0, height = 0, channels = 0;
 
-        // Image data.
-        uint8_t* data = NULL;
+        // Reference-counted pixel buffer, shared by the copies of the image (defined in image.cpp).
+        struct Buffer;
+        std::shared_ptr<Buffer> buffer;
         
         // Flag to specify whether the image is in SoA architecture.
         bool is_SoA = false;
 
+        // Flag to specify whether the color channels of the image are identical.
+        bool is_grayscale = false;
+
+
+        // Constructors.
+
+        /*
+            * Create an image with the given dimensions over an existing pixel buffer.
+            *
+            * @param width The width of the image.
+            * @param height The height of the image.
+            * @param channels The number of channels of the image.
+            * @param is_SoA Whether the image is in SoA architecture.
+            * @param buffer The pixel buffer.
+        */
+        BasicImage(const int width, const int height, const int channels, const bool is_SoA, const std::shared_ptr<Buffer>& buffer);
+
 
         // Methods.
 
         /*
-            * Convert the image data from AoS to SoA architecture.
+            * Allocate a new unshared pixel buffer.
+            *
+            * @param size The size of the buffer.
+            * @param zero Whether the buffer must be zero initialized.
+            * 
+            * @return The pixel buffer.
+        */
+        static std::shared_ptr<Buffer> allocate(const size_t size, const bool zero);
+
+        /*
+            * Make the pixel buffer exclusive to this image before it is mutated (copy-on-write).
         */
-        void AoS_to_SoA();
+        void detach();
 
         /*
-            * Convert the image data from SoA to AoS architecture.
+            * Fill the columns [begin, end) of a padded row from the input row.
+            *
+            * @param padded_row The padded row.
+            * @param input_row The input row.
+            * @param column_table The source column of every padded column.
+            * @param begin The first padded column to fill.
+            * @param end The last padded column to fill (excluded).
+            * @param pixel_size The number of samples per pixel in the row.
+            * @param padding_type The padding type.
         */
-        void SoA_to_AoS();
+        static void fill_border(T* padded_row, const T* input_row, const std::vector<int>& column_table, const int begin, const int end, const int pixel_size, const PaddingType padding_type);
+
+        /*
+            * Check whether the first three channels of every pixel of AoS data are identical.
+            *
+            * @param data The image data in AoS architecture.
+            * @param pixels The number of pixels.
+            * @param channels The number of channels (at least 3).
+            * 
+            * @return True if R == G == B for every pixel, false otherwise.
+        */
+        static bool detect_grayscale(const T* data, const size_t pixels, const int channels);
 };
 
-#endif // IMAGE_H
\ No newline at end of file
+
+// 8 bits image, the native format of the convolution engines.
+typedef BasicImage<uint8_t> Image;
+
+#endif // IMAGE_H
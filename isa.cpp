@@ -0,0 +1,78 @@
+#include <iostream>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "isa.h"
+
+
+// Active instruction set.
+
+std::atomic<int> Isa::instruction_set{-1};
+
+
+// Getters.
+
+InstructionSet Isa::get_supported() {
+#if ISA_DISPATCH
+    // The CPU features are checked along with the OS support of the wider register states.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return InstructionSet::AVX512;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return InstructionSet::AVX2;
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        return InstructionSet::SSE4_2;
+    }
+#endif
+
+    return InstructionSet::BASELINE;
+}
+
+
+// Setters.
+
+void Isa::set_instruction_set(const InstructionSet instruction_set) {
+    // Check if the CPU supports the instruction set.
+    if ((int)instruction_set > (int)get_supported()) {
+        std::cerr << "Error: The instruction set " << to_string(instruction_set) << " is not supported by this CPU (up to " << to_string(get_supported()) << ")." << std::endl;
+        throw std::invalid_argument("Unsupported instruction set.");
+    }
+
+    Isa::instruction_set.store((int)instruction_set, std::memory_order_relaxed);
+}
+
+
+// Methods.
+
+InstructionSet Isa::parse(const std::string& name) {
+    if (name == "baseline") {
+        return InstructionSet::BASELINE;
+    } else if (name == "sse4.2") {
+        return InstructionSet::SSE4_2;
+    } else if (name == "avx2") {
+        return InstructionSet::AVX2;
+    } else if (name == "avx512") {
+        return InstructionSet::AVX512;
+    }
+
+    std::cerr << "Error: Invalid instruction set: " << name << "." << std::endl;
+    throw std::invalid_argument("Invalid instruction set: " + name + ".");
+}
+
+std::string Isa::to_string(const InstructionSet instruction_set) {
+    switch (instruction_set) {
+        case InstructionSet::SSE4_2: return "sse4.2";
+        case InstructionSet::AVX2: return "avx2";
+        case InstructionSet::AVX512: return "avx512";
+        default: return "baseline";
+    }
+}
+
+InstructionSet Isa::initialize() {
+    // Force the instruction set named by the environment, if any.
+    const char* name = std::getenv("KIP_ISA"); // Forced instruction set name.
+    const InstructionSet active = (name != NULL && name[0] != '\0') ? parse(name) : get_supported(); // Active instruction set.
+
+    set_instruction_set(active);
+    return active;
+}
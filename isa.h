@@ -0,0 +1,111 @@
+#ifndef ISA_H
+#define ISA_H
+
+#include <string>
+#include <atomic>
+
+
+// Instruction sets of the CPU primitives dispatched at runtime, from the narrowest to the widest.
+enum class InstructionSet {
+    BASELINE, // Portable code, compiled for the build flags.
+    SSE4_2, // 128-bit vectors.
+    AVX2, // 256-bit vectors (with FMA).
+    AVX512 // 512-bit vectors (AVX-512 F and BW).
+};
+
+
+// Per-ISA variants are compiled with target attributes (x86 GCC and Clang builds only, the other ones run the baseline variants).
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ISA_DISPATCH 1
+#define ISA_TARGET_SSE4_2 __attribute__((target("sse4.2")))
+#define ISA_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define ISA_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx2,fma")))
+#else
+#define ISA_DISPATCH 0
+#endif
+
+// Body shared by the per-ISA variants of a primitive, inlined (and vectorised) into each of them.
+#if defined(__GNUC__)
+#define ISA_INLINE inline __attribute__((always_inline))
+#else
+#define ISA_INLINE inline
+#endif
+
+// Variant inlining every call of its body, including the helpers compiled for its instruction set.
+#if defined(__GNUC__)
+#define ISA_FLATTEN __attribute__((flatten))
+#else
+#define ISA_FLATTEN
+#endif
+
+
+class Isa {
+    public:
+        // Getters.
+
+        /*
+            * Get the widest instruction set supported by the CPU and the operating system.
+            *
+            * @return The supported instruction set.
+        */
+        static InstructionSet get_supported();
+
+        /*
+            * Get the instruction set of the dispatched primitives (the supported one, unless forced by the KIP_ISA environment
+            * variable or set_instruction_set).
+            *
+            * @return The active instruction set.
+        */
+        static InstructionSet get_instruction_set() {
+            const int value = instruction_set.load(std::memory_order_relaxed);
+            return (value >= 0) ? (InstructionSet)value : initialize();
+        }
+
+
+        // Setters.
+
+        /*
+            * Force the instruction set of the dispatched primitives (e.g. for reproducible benchmarks).
+            *
+            * @param instruction_set The instruction set (not wider than the supported one).
+        */
+        static void set_instruction_set(const InstructionSet instruction_set);
+
+
+        // Methods.
+
+        /*
+            * Parse an instruction set name.
+            *
+            * @param name The instruction set name ('baseline', 'sse4.2', 'avx2' or 'avx512').
+            *
+            * @return The instruction set.
+        */
+        static InstructionSet parse(const std::string& name);
+
+        /*
+            * Get the name of an instruction set.
+            *
+            * @param instruction_set The instruction set.
+            *
+            * @return The instruction set name.
+        */
+        static std::string to_string(const InstructionSet instruction_set);
+
+
+    private:
+        // Active instruction set (-1 until the first dispatch).
+        static std::atomic<int> instruction_set;
+
+
+        // Methods.
+
+        /*
+            * Set the active instruction set from the KIP_ISA environment variable, or to the supported one.
+            *
+            * @return The active instruction set.
+        */
+        static InstructionSet initialize();
+};
+
+#endif // ISA_H
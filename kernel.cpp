@@ -1,6 +1,11 @@
 #include <sstream>
 #include <iomanip>
 #include <iostream>
+#include <cstring>
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
 
 #include "kernel.h"
 
@@ -27,7 +32,7 @@ Kernel::Kernel(const int width, const int height) : width(width), height(height)
     // Calculate the size of the kernel.
     size_t size = get_size();
 
-    // Allocate memory for the kernel.
+    // Allocate memory for the kernel (analyzed on the first access to its properties, once its data is written).
     data = new float[size]{0};
 }
 
@@ -37,6 +42,15 @@ Kernel::Kernel(const int width, const int height, float *data) : Kernel(width, h
 
     // Copy the kernel data.
     memcpy(this->data, data, size * sizeof(float));
+
+    // Analyze the kernel.
+    properties = std::make_shared<const KernelProperties>(analyze());
+}
+
+Kernel::Kernel(const Kernel& kernel) : Kernel(kernel.width, kernel.height) {
+    // Copy the kernel data and share its (immutable) properties.
+    memcpy(data, kernel.data, get_size() * sizeof(float));
+    properties = std::atomic_load(&kernel.properties);
 }
 
 Kernel::~Kernel() {
@@ -59,10 +73,48 @@ size_t Kernel::get_size() const {
     return (size_t)(width * height);
 }
 
-float* Kernel::get_data() const {
+const float* Kernel::get_data() const {
     return data;
 }
 
+float* Kernel::get_data() {
+    // The data may be modified through the returned pointer.
+    std::atomic_store(&properties, std::shared_ptr<const KernelProperties>());
+
+    return data;
+}
+
+std::shared_ptr<const KernelProperties> Kernel::get_properties() const {
+    // Recompute the properties if the data may have been modified.
+    std::shared_ptr<const KernelProperties> current = std::atomic_load(&properties);
+    if (!current) {
+        current = std::make_shared<const KernelProperties>(analyze());
+        std::atomic_store(&properties, current);
+    }
+
+    return current;
+}
+
+uint64_t Kernel::get_hash() const {
+    // FNV-1a hash of the dimensions and of the weight bits.
+    uint64_t hash = 14695981039346656037ull;
+    const auto mix = [&hash](const uint32_t word) {
+        for (int byte = 0; byte < 4; byte++) {
+            hash = (hash ^ ((word >> (8 * byte)) & 0xFF)) * 1099511628211ull;
+        }
+    };
+
+    mix((uint32_t)width);
+    mix((uint32_t)height);
+    for (int i = 0; i < width * height; i++) {
+        uint32_t bits; // Weight bits.
+        memcpy(&bits, &data[i], sizeof(bits));
+        mix(bits);
+    }
+
+    return hash;
+}
+
 
 // Predefined kernels.
 
@@ -149,9 +201,95 @@ Kernel Kernel::custom_kernel(const int size, float* data, const bool normalize)
 }
 
 
+// Composition.
+
+Kernel Kernel::compose(const Kernel& other) const {
+    // The taps of the composed kernel are the sums of the products of the taps whose offsets add up to theirs.
+    Kernel result(width + other.width - 1, height + other.height - 1); // Composed kernel.
+    const std::shared_ptr<const KernelProperties> properties = get_properties(), other_properties = other.get_properties(); // Kernel properties.
+    for (const KernelTap& tap : properties->taps) {
+        for (const KernelTap& other_tap : other_properties->taps) {
+            result.data[(tap.dy + other_tap.dy + result.height / 2) * result.width + (tap.dx + other_tap.dx + result.width / 2)] += tap.weight * other_tap.weight;
+        }
+    }
+
+    // Analyze the composed kernel.
+    result.properties = std::make_shared<const KernelProperties>(result.analyze());
+
+    return result;
+}
+
+Kernel Kernel::compose(const std::vector<Kernel>& kernels) {
+    // Check if there is at least one kernel.
+    if (kernels.empty()) {
+        std::cerr << "Error: Expected at least one kernel to compose." << std::endl;
+        throw std::invalid_argument("No kernels to compose.");
+    }
+
+    // Compose the kernels in the order in which they are applied.
+    Kernel result = kernels[0]; // Composed kernel.
+    for (size_t i = 1; i < kernels.size(); i++) {
+        result = result.compose(kernels[i]);
+    }
+
+    return result;
+}
+
+
 // Operators.
 
-float &Kernel::operator()(const int col, const int row) const {
+Kernel Kernel::operator+(const Kernel& other) const {
+    // Add both kernels to a zero kernel of the largest dimensions, centered on each other.
+    Kernel result(std::max(width, other.width), std::max(height, other.height)); // Sum kernel.
+    for (const Kernel* kernel : {this, &other}) {
+        const int offset_x = (result.width - kernel->width) / 2; // Column of the kernel in the result.
+        const int offset_y = (result.height - kernel->height) / 2; // Row of the kernel in the result.
+        for (int row = 0; row < kernel->height; row++) {
+            for (int col = 0; col < kernel->width; col++) {
+                result.data[(row + offset_y) * result.width + (col + offset_x)] += kernel->data[row * kernel->width + col];
+            }
+        }
+    }
+
+    // Analyze the sum kernel.
+    result.properties = std::make_shared<const KernelProperties>(result.analyze());
+
+    return result;
+}
+
+Kernel Kernel::operator*(const float scale) const {
+    // Scale every weight.
+    Kernel result(width, height); // Scaled kernel.
+    for (size_t i = 0; i < get_size(); i++) {
+        result.data[i] = data[i] * scale;
+    }
+
+    // Analyze the scaled kernel.
+    result.properties = std::make_shared<const KernelProperties>(result.analyze());
+
+    return result;
+}
+
+Kernel &Kernel::operator=(const Kernel &other) {
+    // Check if the kernels are different.
+    if (this != &other) {
+        // Reallocate the kernel data if the size changes.
+        if (get_size() != other.get_size()) {
+            delete[] data;
+            data = new float[other.get_size()];
+        }
+
+        // Copy the kernel dimensions and data.
+        width = other.width;
+        height = other.height;
+        memcpy(data, other.data, get_size() * sizeof(float));
+        std::atomic_store(&properties, std::atomic_load(&other.properties));
+    }
+
+    return *this;
+}
+
+const float &Kernel::operator()(const int col, const int row) const {
     // Check if the coordinates are valid.
     if ((col < 0 || col >= width) || (row < 0 || row >= height)) {
         std::cerr << "Error: Invalid kernel coordinates (" << col << ", " << row << ")." << std::endl;
@@ -164,6 +302,13 @@ float &Kernel::operator()(const int col, const int row) const {
     return data[kernel_index];
 }
 
+float &Kernel::operator()(const int col, const int row) {
+    // The value may be modified through the returned reference.
+    std::atomic_store(&properties, std::shared_ptr<const KernelProperties>());
+
+    return const_cast<float&>(static_cast<const Kernel&>(*this)(col, row));
+}
+
 std::ostream &operator<<(std::ostream &os, const Kernel &kernel) {
     // Calculate the maximum element width.
     std::string str;
@@ -194,8 +339,158 @@ std::ostream &operator<<(std::ostream &os, const Kernel &kernel) {
         os << std::endl;
     }
 
+    // Print the kernel properties.
+    const std::shared_ptr<const KernelProperties> properties = kernel.get_properties(); // Kernel properties.
+    os << "Kernel properties: sum " << properties->sum << ", rank " << properties->rank << (properties->is_separable ? " (separable)" : "");
+    os << ", " << properties->taps.size() << "/" << kernel.get_size() << " non-zero taps (" << properties->tap_groups.size() << " distinct by symmetry)";
+    if (properties->is_radially_symmetric) os << ", radially symmetric";
+    else if (properties->is_horizontally_symmetric || properties->is_vertically_symmetric || properties->is_point_symmetric) {
+        os << ", symmetric (" << (properties->is_horizontally_symmetric ? "H" : "") << (properties->is_vertically_symmetric ? "V" : "") << (properties->is_point_symmetric ? "P" : "") << ")";
+    }
+    if (properties->is_integer) os << ", integer";
+    else if (properties->is_dyadic) os << ", dyadic (1/" << (1 << properties->dyadic_shift) << ")";
+    os << ", output range [" << properties->output_min << ", " << properties->output_max << "]" << (properties->is_output_in_range ? " (no clamp)" : "") << std::endl;
+
     // Restore the output format
     os << std::defaultfloat;
 
     return os;
+}
+
+
+// Private methods.
+
+KernelProperties Kernel::analyze() const {
+    KernelProperties properties;
+
+    // Kernel center.
+    const int center_x = width / 2; // Column of the center.
+    const int center_y = height / 2; // Row of the center.
+
+    // Sum, non-zero taps and output range.
+    double positive_sum = 0, negative_sum = 0; // Sums of the positive and negative weights.
+    for (int row = 0; row < height; row++) {
+        for (int col = 0; col < width; col++) {
+            const float weight = data[row * width + col];
+            properties.sum += weight;
+
+            if (weight != 0) {
+                KernelTap tap;
+                tap.dx = col - center_x;
+                tap.dy = row - center_y;
+                tap.weight = weight;
+                properties.taps.push_back(tap);
+            }
+
+            if (weight > 0) positive_sum += weight;
+            else negative_sum += weight;
+        }
+    }
+    properties.density = (float)properties.taps.size() / get_size();
+    properties.output_min = (float)(255.0 * negative_sum);
+    properties.output_max = (float)(255.0 * positive_sum);
+
+    // The float accumulation may slightly overshoot the exact range, hence the margin: values in (-1, 256) truncate to [0, 255].
+    properties.is_output_in_range = (properties.output_min > -1.0f + 1e-3f) && (properties.output_max < 256.0f - 1e-3f);
+
+    // Symmetries.
+    properties.is_horizontally_symmetric = properties.is_vertically_symmetric = properties.is_point_symmetric = true;
+    bool is_transpose_symmetric = (width == height); // Whether the kernel is unchanged by transposition.
+    for (int row = 0; row < height; row++) {
+        for (int col = 0; col < width; col++) {
+            const float weight = data[row * width + col];
+            if (weight != data[row * width + (width - 1 - col)]) properties.is_horizontally_symmetric = false;
+            if (weight != data[(height - 1 - row) * width + col]) properties.is_vertically_symmetric = false;
+            if (weight != data[(height - 1 - row) * width + (width - 1 - col)]) properties.is_point_symmetric = false;
+            if (is_transpose_symmetric && weight != data[col * width + row]) is_transpose_symmetric = false;
+        }
+    }
+    properties.is_radially_symmetric = properties.is_horizontally_symmetric && properties.is_vertically_symmetric && is_transpose_symmetric;
+
+    // Group the taps with their mirrored images, whose weights are equal.
+    std::vector<bool> is_grouped(get_size(), false); // Whether each tap already belongs to a group.
+    for (const KernelTap& tap : properties.taps) {
+        if (is_grouped[(tap.dy + center_y) * width + (tap.dx + center_x)]) { continue; }
+
+        // Images of the tap by the flips, the 180 degrees rotation and the transposed ones.
+        const int images[8][2] = {
+            {tap.dx, tap.dy}, {-tap.dx, tap.dy}, {tap.dx, -tap.dy}, {-tap.dx, -tap.dy},
+            {tap.dy, tap.dx}, {-tap.dy, tap.dx}, {tap.dy, -tap.dx}, {-tap.dy, -tap.dx}
+        };
+        const bool is_image[8] = {
+            true, properties.is_horizontally_symmetric, properties.is_vertically_symmetric, properties.is_point_symmetric,
+            properties.is_radially_symmetric, properties.is_radially_symmetric, properties.is_radially_symmetric, properties.is_radially_symmetric
+        };
+
+        KernelTapGroup group;
+        group.weight = tap.weight;
+        for (int i = 0; i < 8; i++) {
+            const int image_index = (images[i][1] + center_y) * width + (images[i][0] + center_x); // Index of the image tap.
+            if (is_image[i] && !is_grouped[image_index]) {
+                is_grouped[image_index] = true;
+                group.offsets.push_back(std::make_pair(images[i][0], images[i][1]));
+            }
+        }
+        properties.tap_groups.push_back(group);
+    }
+
+    // Integer and dyadic weights.
+    properties.is_integer = true;
+    for (size_t i = 0; i < get_size(); i++) {
+        if (std::floor(data[i]) != data[i]) { properties.is_integer = false; }
+    }
+    for (int shift = 0; shift <= 16 && !properties.is_dyadic; shift++) {
+        bool is_dyadic = true;
+        for (size_t i = 0; i < get_size() && is_dyadic; i++) {
+            const double scaled = std::ldexp((double)data[i], shift);
+            is_dyadic = (std::floor(scaled) == scaled);
+        }
+        if (is_dyadic) {
+            properties.is_dyadic = true;
+            properties.dyadic_shift = shift;
+        }
+    }
+
+    // Rank (Gaussian elimination with partial pivoting).
+    std::vector<double> matrix(data, data + get_size()); // Working copy of the weights.
+    double max_weight = 0; // Largest absolute weight.
+    for (size_t i = 0; i < get_size(); i++) { max_weight = std::max(max_weight, std::fabs(matrix[i])); }
+    const double tolerance = 1e-6 * std::max(max_weight, 1e-30); // Threshold for zero pivots.
+    for (int col = 0, pivot_row = 0; col < width && pivot_row < height; col++) {
+        // Find the pivot.
+        int best_row = pivot_row;
+        for (int row = pivot_row + 1; row < height; row++) {
+            if (std::fabs(matrix[row * width + col]) > std::fabs(matrix[best_row * width + col])) { best_row = row; }
+        }
+        if (std::fabs(matrix[best_row * width + col]) <= tolerance) { continue; }
+
+        // Swap the pivot row into place and eliminate the column below it.
+        for (int i = 0; i < width; i++) { std::swap(matrix[pivot_row * width + i], matrix[best_row * width + i]); }
+        for (int row = pivot_row + 1; row < height; row++) {
+            const double factor = matrix[row * width + col] / matrix[pivot_row * width + col];
+            for (int i = col; i < width; i++) { matrix[row * width + i] -= factor * matrix[pivot_row * width + i]; }
+        }
+
+        pivot_row++;
+        properties.rank++;
+    }
+
+    // Separable factors from the largest weight: kernel = (column / pivot) * row.
+    properties.is_separable = (properties.rank <= 1);
+    if (properties.is_separable) {
+        int pivot = 0; // Index of the largest absolute weight.
+        for (size_t i = 1; i < get_size(); i++) {
+            if (std::fabs(data[i]) > std::fabs(data[pivot])) { pivot = (int)i; }
+        }
+        const int pivot_x = pivot % width; // Column of the pivot.
+        const int pivot_y = pivot / width; // Row of the pivot.
+
+        properties.row_vector.assign(data + pivot_y * width, data + (pivot_y + 1) * width);
+        properties.column_vector.resize(height);
+        for (int row = 0; row < height; row++) {
+            properties.column_vector[row] = (data[pivot] != 0) ? data[row * width + pivot_x] / data[pivot] : 0;
+        }
+    }
+
+    return properties;
 }
\ No newline at end of file
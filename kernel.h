@@ -3,6 +3,74 @@
 
 #include <stdint.h>
 #include <cstdio>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+// Non-zero kernel tap.
+struct KernelTap {
+    // Offset of the tap from the kernel center.
+    int dx = 0, dy = 0;
+
+    // Weight of the tap.
+    float weight = 0;
+};
+
+
+// Non-zero kernel taps sharing their weight by symmetry.
+struct KernelTapGroup {
+    // Shared weight of the taps.
+    float weight = 0;
+
+    // Offsets (dx, dy) of the taps from the kernel center.
+    std::vector<std::pair<int, int>> offsets;
+};
+
+
+// Structural properties of a kernel, computed once and used by the convolution engines to choose their algorithm.
+struct KernelProperties {
+    // Sum of the weights.
+    float sum = 0;
+
+    // Numerical rank of the weight matrix.
+    int rank = 0;
+
+    // Whether the kernel is the outer product of a column and a row vector (rank <= 1).
+    bool is_separable = false;
+
+    // Separable factors, such that kernel(col, row) = column_vector[row] * row_vector[col] (empty if not separable).
+    std::vector<float> column_vector, row_vector;
+
+    // Whether the kernel is unchanged by a left-right flip, a top-bottom flip, a 180 degrees rotation,
+    // and by every symmetry of the square (flips, rotations and transposition) respectively.
+    bool is_horizontally_symmetric = false, is_vertically_symmetric = false, is_point_symmetric = false, is_radially_symmetric = false;
+
+    // Non-zero taps (in row-major order).
+    std::vector<KernelTap> taps;
+
+    // Non-zero taps grouped by the kernel symmetries (a group per tap for asymmetric kernels).
+    std::vector<KernelTapGroup> tap_groups;
+
+    // Fraction of non-zero taps.
+    float density = 0;
+
+    // Whether every weight is an integer.
+    bool is_integer = false;
+
+    // Whether every weight is a dyadic rational (integer / 2^dyadic_shift).
+    bool is_dyadic = false;
+
+    // Smallest power of two that makes every weight an integer (when dyadic).
+    int dyadic_shift = 0;
+
+    // Range of the output values for uint8 input, before clamping.
+    float output_min = 0, output_max = 0;
+
+    // Whether the output values provably convert to [0, 255] without clamping.
+    bool is_output_in_range = false;
+};
+
 
 
 class Kernel {
@@ -26,6 +94,13 @@ class Kernel {
         */
         Kernel(const int width, const int height, float *data);
 
+        /*
+            * Copy constructor for a kernel.
+            *
+            * @param kernel The kernel to be copied.
+        */
+        Kernel(const Kernel& kernel);
+
         /*
             * Destructor.
         */
@@ -56,11 +131,33 @@ class Kernel {
         size_t get_size() const;
 
         /*
-            * Get the kernel data.
+            * Get the kernel data for reading.
+            *
+            * @return The kernel data.
+        */
+        const float* get_data() const;
+
+        /*
+            * Get the kernel data for writing (the cached properties are recomputed on the next access).
             *
             * @return The kernel data.
         */
-        float* get_data() const;
+        float* get_data();
+
+        /*
+            * Get the structural properties of the kernel (computed on the first access after the data is written, and cached).
+            * The returned properties stay valid when the data is modified afterwards (the cache then gets new properties).
+            *
+            * @return The kernel properties.
+        */
+        std::shared_ptr<const KernelProperties> get_properties() const;
+
+        /*
+            * Get a hash of the kernel dimensions and weights (e.g. to cache the code compiled for the kernel).
+            *
+            * @return The kernel hash.
+        */
+        uint64_t get_hash() const;
 
 
         // Predefined kernels.
@@ -122,17 +219,74 @@ class Kernel {
         static Kernel custom_kernel(const int size, float *data, const bool normalize = true);
 
 
+        // Composition.
+
+        /*
+            * Compose the kernel with another one: convolving with the result is equivalent to convolving with this kernel
+            * and then with the other one (without the intermediate clamp and, at the borders, with the padding of the result).
+            *
+            * @param other The kernel applied after this one.
+            *
+            * @return The composed kernel, whose size is the sum of the sizes minus one.
+        */
+        Kernel compose(const Kernel& other) const;
+
+        /*
+            * Compose a chain of kernels into one equivalent kernel.
+            *
+            * @param kernels The kernels, in the order in which they are applied.
+            *
+            * @return The composed kernel.
+        */
+        static Kernel compose(const std::vector<Kernel>& kernels);
+
+
         // Operators.
 
         /*
-            * Get the kernel value at the given position.
+            * Sum two kernels (centered on each other, the smaller one padded with zeros).
+            *
+            * @param other The kernel to be added.
+            *
+            * @return The sum kernel.
+        */
+        Kernel operator+(const Kernel& other) const;
+
+        /*
+            * Scale the kernel weights.
+            *
+            * @param scale The scale factor.
+            *
+            * @return The scaled kernel.
+        */
+        Kernel operator*(const float scale) const;
+
+        /*
+            * Assignment operator for a kernel.
+            *
+            * @param other The kernel to be assigned.
+        */
+        Kernel& operator=(const Kernel& other);
+
+        /*
+            * Get the kernel value at the given position for reading.
+            *
+            * @param col The column of the kernel value.
+            * @param row The row of the kernel value.
+            *
+            * @return The kernel value at the given position.
+        */
+        const float& operator()(const int col, const int row) const;
+
+        /*
+            * Get the kernel value at the given position for writing (the cached properties are recomputed on the next access).
             *
             * @param col The column of the kernel value.
             * @param row The row of the kernel value.
             *
             * @return The kernel value at the given position.
         */
-        float& operator()(const int col, const int row) const;
+        float& operator()(const int col, const int row);
         
         /*
             * Print the kernel.
@@ -147,6 +301,19 @@ class Kernel {
         int width = 0, height = 0;
         // Kernel data.
         float *data = NULL;
+
+        // Cached kernel properties (NULL when the data may have been modified).
+        mutable std::shared_ptr<const KernelProperties> properties;
+
+
+        // Methods.
+
+        /*
+            * Analyze the structure of the kernel.
+            *
+            * @return The kernel properties.
+        */
+        KernelProperties analyze() const;
 };
 
 #endif // KERNEL_H
\ No newline at end of file
@@ -8,18 +8,40 @@
 #include "params.h"
 #include "image.h"
 #include "kernel.h"
+#include "thread_pool.h"
+#include "isa.h"
+#include "tuner.h"
 #include "./parallel/convolution.h"
 #include "./sequential/convolution.h"
+#include "./sequential/expression.h"
 
 
 std::string IMAGE_PATH = "";
 static bool SOA = false;
+static bool AOS = false;
+static bool TUNE = false;
+static bool GRAYSCALE_OUTPUT = false;
+static std::string COLOR_MODE = "rgb";
+static uint32_t CHANNEL_MASK = ALL_CHANNELS;
+static std::vector<std::string> CHANNEL_KERNELS;
+static std::vector<std::string> FILTER_BANK;
+static std::vector<std::string> PIPELINE;
+static bool SEPARABLE = false;
+static bool FUSED = false;
+static int KERNEL_ITERATIONS = 1;
+static float SIGMA = 0;
+static Sequential::GaussianMethod GAUSSIAN_METHOD = Sequential::RECURSIVE_GAUSSIAN;
+static std::string RECIPE = "";
+static std::string SAMPLE_TYPE = "uint8";
 static PaddingType PADDING_TYPE = PaddingType::MIRROR;
 static std::string KERNEL = "";
 static int KERNEL_SIZE = 0;
 static float* KERNEL_DATA = nullptr;
 static bool KERNEL_NORMALIZATION = false;
 static std::string EXECUTION_TYPE = "";
+static int THREADS = 1;
+static bool PIN_THREADS = false;
+static std::string ISA = "";
 static std::string MEMORY_TYPE = "";
 static std::string OUTPUT_PATH = "";
 static std::string RESULTS_PATH = ".\\results\\";
@@ -31,13 +53,31 @@ void printHelp() {
     std::cout << "  --help, -h: Display this help message." << std::endl;
     std::cout << "  --image_path, -I: Path to the input image file." << std::endl;
     std::cout << "  --SoA, -S: Use Structure of Arrays (SoA) data layout." << std::endl;
+    std::cout << "  --AoS: Use Array of Structures (AoS) data layout (default: the tuned one)." << std::endl;
+    std::cout << "  --grayscale_output, -G: Emit a single channel output for images whose color channels are identical (alpha is dropped)." << std::endl;
     std::cout << "  --padding_type, -P: Padding type ('zero', 'replicate' or 'mirror')." << std::endl;
     std::cout << "  --kernel, -K: Kernel type ('box_blur', 'gaussian_blur', 'sharpen', 'edge_detection', 'unsharpen_mask', 'emboss' or 'custom')." << std::endl;
     std::cout << "  --kernel_size, -Z: Size of the custom kernel (required 'custom' kernel)." << std::endl;
     std::cout << "  --kernel_data, -D: Data of the custom kernel (required 'custom' kernel with specific 'kernel_size')." << std::endl;
     std::cout << "  --kernel_normalization, -N: Normalization of the custom kernel (required 'custom' kernel)." << std::endl;
+    std::cout << "  --channels, -A: Channels to be convolved ('r', 'g', 'b', 'a' or channel indices, e.g. 'rgb'); the other ones are copied through." << std::endl;
+    std::cout << "  --channel_kernels, -L: Comma separated kernel of each channel ('none' to copy it through), replacing '--kernel' (sequential only)." << std::endl;
+    std::cout << "  --filter_bank, -F: Comma separated kernels applied in one pass, each saved with its name appended to the output path, replacing '--kernel' (sequential only)." << std::endl;
+    std::cout << "  --pipeline, -Q: Comma separated kernels ('median', 'erosion' and 'dilation' for 3x3 windows) applied one after the other, collapsed into one kernel when linear, replacing '--kernel' (sequential only)." << std::endl;
+    std::cout << "  --separable: Apply a separable collapsed pipeline kernel as a vertical and a horizontal 1D pass." << std::endl;
+    std::cout << "  --fused: Apply the pipeline stages tile by tile, clamping between them, instead of collapsing them." << std::endl;
+    std::cout << "  --iterations, -W: Number of applications of the kernel, clamped after each one and run tile by tile in cache (default: 1) (sequential only)." << std::endl;
+    std::cout << "  --sigma, -V: Standard deviation of a gaussian blur of any size (at least 0.5), applied by a recursive filter at a constant cost per pixel, replacing '--kernel' (sequential only)." << std::endl;
+    std::cout << "  --gaussian_method, -B: Approximation of the '--sigma' gaussian ('recursive' within one level of the exact kernel, or 'box' for successive box blurs, e.g. previews) (default: 'recursive')." << std::endl;
+    std::cout << "  --recipe, -X: Enhancement evaluated in one fused pass ('unsharp' for 2 * image - gaussian blur, 'dog' for the difference of gaussians), replacing '--kernel' (sequential only)." << std::endl;
+    std::cout << "  --sample_type, -Y: Sample type of the convolved image ('uint8', 'uint16', 'int16' or 'float', saved as is to '.hdr' outputs and quantised to 8 bits otherwise) (sequential only)." << std::endl;
+    std::cout << "  --color_mode, -C: Channels to be convolved ('rgb', 'luma' to convolve the luma and keep the chroma, or 'luma_only' to output the convolved luma)." << std::endl;
     std::cout << "  --execution_type, -E: Execution type ('parallel' or 'sequential')." << std::endl;
+    std::cout << "  --threads, -T: Number of CPU threads of the sequential execution type (default: 1, 0 for one per hardware thread)." << std::endl;
+    std::cout << "  --pin_threads: Pin the CPU threads to the CPUs of their NUMA node, and queue the row bands per node." << std::endl;
+    std::cout << "  --isa: Instruction set of the CPU primitives ('baseline', 'sse4.2', 'avx2' or 'avx512', default: the KIP_ISA environment variable, or the widest supported one)." << std::endl;
     std::cout << "  --memory_type, -M: Memory management type ('global', 'constant', 'shared' or 'pinned')." << std::endl;
+    std::cout << "  --tune: Benchmark the layouts, band sizes and memory types for this image and kernel size, and cache the fastest ones." << std::endl;
     std::cout << "  --output_path, -O: Path to the output image file." << std::endl;
     std::cout << "  --results_path, -R: Base path for the results (default: './results/')." << std::endl;
 }
@@ -56,6 +96,12 @@ int processInput(int argc, char* argv[]) {
             IMAGE_PATH = strchr(arg, '=') + 1;
         } else if (strcmp(arg, "--SoA") == 0 || strcmp(arg, "-S") == 0) {
             SOA = true;
+        } else if (strcmp(arg, "--AoS") == 0) {
+            AOS = true;
+        } else if (strcmp(arg, "--tune") == 0) {
+            TUNE = true;
+        } else if (strcmp(arg, "--grayscale_output") == 0 || strcmp(arg, "-G") == 0) {
+            GRAYSCALE_OUTPUT = true;
         } else if (strncmp(arg, "--padding_type=", 15) == 0 || strncmp(arg, "-P=", 3) == 0) {
             // Set the padding type.
             const char *value = strchr(arg, '=') + 1;
@@ -154,6 +200,119 @@ int processInput(int argc, char* argv[]) {
         } else if ((KERNEL == "custom") && (strcmp(arg, "--kernel_normalization") == 0 || strcmp(arg, "-N") == 0)) {
             // Normalize the kernel.
             KERNEL_NORMALIZATION = true;
+        } else if (strncmp(arg, "--channels=", 11) == 0 || strncmp(arg, "-A=", 3) == 0) {
+            // Set the channel mask.
+            const char *value = strchr(arg, '=') + 1;
+
+            CHANNEL_MASK = 0;
+            for (const char *c = value; *c != '\0'; c++) {
+                const char *letter = strchr("rgba", *c); // Channel letter.
+                if (letter != NULL) {
+                    CHANNEL_MASK |= (1u << (letter - "rgba"));
+                } else if (*c >= '0' && *c <= '9') {
+                    CHANNEL_MASK |= (1u << (*c - '0'));
+                } else {
+                    // Invalid channel.
+                    std::cerr << "Invalid argument for channels." << std::endl;
+                    return 1;
+                }
+            }
+        } else if (strncmp(arg, "--channel_kernels=", 18) == 0 || strncmp(arg, "-L=", 3) == 0) {
+            // Split the channel kernels.
+            std::stringstream ss(strchr(arg, '=') + 1); // Input string stream.
+            std::string name; // Kernel name.
+            while (std::getline(ss, name, ',')) {
+                CHANNEL_KERNELS.push_back(name);
+            }
+        } else if (strncmp(arg, "--filter_bank=", 14) == 0 || strncmp(arg, "-F=", 3) == 0) {
+            // Split the filter bank kernels.
+            std::stringstream ss(strchr(arg, '=') + 1); // Input string stream.
+            std::string name; // Kernel name.
+            while (std::getline(ss, name, ',')) {
+                FILTER_BANK.push_back(name);
+            }
+        } else if (strncmp(arg, "--pipeline=", 11) == 0 || strncmp(arg, "-Q=", 3) == 0) {
+            // Split the pipeline kernels.
+            std::stringstream ss(strchr(arg, '=') + 1); // Input string stream.
+            std::string name; // Kernel name.
+            while (std::getline(ss, name, ',')) {
+                PIPELINE.push_back(name);
+            }
+        } else if (strcmp(arg, "--separable") == 0) {
+            SEPARABLE = true;
+        } else if (strcmp(arg, "--fused") == 0) {
+            FUSED = true;
+        } else if (strncmp(arg, "--iterations=", 13) == 0 || strncmp(arg, "-W=", 3) == 0) {
+            KERNEL_ITERATIONS = std::stoi(strchr(arg, '=') + 1);
+
+            if (KERNEL_ITERATIONS < 1) {
+                // Invalid number of iterations.
+                std::cerr << "Invalid argument for iterations." << std::endl;
+                return 1;
+            }
+        } else if (strncmp(arg, "--sigma=", 8) == 0 || strncmp(arg, "-V=", 3) == 0) {
+            SIGMA = std::stof(strchr(arg, '=') + 1);
+
+            if (SIGMA < 0.5f) {
+                // Invalid standard deviation.
+                std::cerr << "Invalid argument for sigma." << std::endl;
+                return 1;
+            }
+        } else if (strncmp(arg, "--gaussian_method=", 18) == 0 || strncmp(arg, "-B=", 3) == 0) {
+            // Set the gaussian approximation.
+            const char *value = strchr(arg, '=') + 1;
+
+            if (strcmp(value, "recursive") == 0) {
+                // Recursive filter.
+                GAUSSIAN_METHOD = Sequential::RECURSIVE_GAUSSIAN;
+            } else if (strcmp(value, "box") == 0) {
+                // Successive box blurs.
+                GAUSSIAN_METHOD = Sequential::BOX_GAUSSIAN;
+            } else {
+                // Invalid gaussian approximation.
+                std::cerr << "Invalid argument for gaussian method." << std::endl;
+                return 1;
+            }
+        } else if (strncmp(arg, "--recipe=", 9) == 0 || strncmp(arg, "-X=", 3) == 0) {
+            // Set the recipe.
+            const char *value = strchr(arg, '=') + 1;
+
+            if (strcmp(value, "unsharp") == 0 || strcmp(value, "dog") == 0) {
+                RECIPE = value;
+            } else {
+                // Invalid recipe.
+                std::cerr << "Invalid argument for recipe." << std::endl;
+                return 1;
+            }
+        } else if (strncmp(arg, "--sample_type=", 14) == 0 || strncmp(arg, "-Y=", 3) == 0) {
+            // Set the sample type.
+            const char *value = strchr(arg, '=') + 1;
+
+            if (strcmp(value, "uint8") == 0 || strcmp(value, "uint16") == 0 || strcmp(value, "int16") == 0 || strcmp(value, "float") == 0) {
+                SAMPLE_TYPE = value;
+            } else {
+                // Invalid sample type.
+                std::cerr << "Invalid argument for sample type." << std::endl;
+                return 1;
+            }
+        } else if (strncmp(arg, "--color_mode=", 13) == 0 || strncmp(arg, "-C=", 3) == 0) {
+            // Set the color mode.
+            const char *value = strchr(arg, '=') + 1;
+
+            if (strcmp(value, "rgb") == 0) {
+                // Convolve every channel.
+                COLOR_MODE = "rgb";
+            } else if (strcmp(value, "luma") == 0) {
+                // Convolve the luma and keep the chroma.
+                COLOR_MODE = "luma";
+            } else if (strcmp(value, "luma_only") == 0) {
+                // Output the convolved luma.
+                COLOR_MODE = "luma_only";
+            } else {
+                // Invalid color mode.
+                std::cerr << "Invalid argument for color mode." << std::endl;
+                return 1;
+            }
         } else if (strncmp(arg, "--execution_type=", 17) == 0 || strncmp(arg, "-E=", 3) == 0) {
             // Set the execution type.
             const char *value = strchr(arg, '=') + 1;
@@ -169,6 +328,27 @@ int processInput(int argc, char* argv[]) {
                 std::cerr << "Invalid argument for execution type." << std::endl;
                 return 1;
             }
+        } else if (strncmp(arg, "--threads=", 10) == 0 || strncmp(arg, "-T=", 3) == 0) {
+            THREADS = std::stoi(strchr(arg, '=') + 1);
+
+            if (THREADS < 0) {
+                // Invalid number of threads.
+                std::cerr << "Invalid argument for threads." << std::endl;
+                return 1;
+            }
+        } else if (strcmp(arg, "--pin_threads") == 0) {
+            PIN_THREADS = true;
+        } else if (strncmp(arg, "--isa=", 6) == 0) {
+            // Set the instruction set.
+            const char *value = strchr(arg, '=') + 1;
+
+            if (strcmp(value, "baseline") == 0 || strcmp(value, "sse4.2") == 0 || strcmp(value, "avx2") == 0 || strcmp(value, "avx512") == 0) {
+                ISA = value;
+            } else {
+                // Invalid instruction set.
+                std::cerr << "Invalid argument for instruction set." << std::endl;
+                return 1;
+            }
         } else if ((EXECUTION_TYPE == "parallel") && (strncmp(arg, "--memory_type=", 14) == 0 || strncmp(arg, "-M=", 3) == 0)) {
             // Set the memory type.
             const char *value = strchr(arg, '=') + 1;
@@ -207,99 +387,294 @@ int processInput(int argc, char* argv[]) {
         }
     }
 
-    if (IMAGE_PATH == "" || KERNEL == "" || EXECUTION_TYPE == "") {
+    if (IMAGE_PATH == "" || (KERNEL == "" && CHANNEL_KERNELS.empty() && FILTER_BANK.empty() && PIPELINE.empty() && RECIPE == "" && SIGMA == 0) || EXECUTION_TYPE == "") {
         std::cout << "Please specify valid values for required parameters." << std::endl;
         return 1;
     }
 
+    if (!CHANNEL_KERNELS.empty() && (EXECUTION_TYPE != "sequential" || COLOR_MODE != "rgb")) {
+        std::cout << "Channel kernels require the sequential execution type and the 'rgb' color mode." << std::endl;
+        return 1;
+    }
+
+    if (!FILTER_BANK.empty() && (EXECUTION_TYPE != "sequential" || COLOR_MODE != "rgb")) {
+        std::cout << "Filter banks require the sequential execution type and the 'rgb' color mode." << std::endl;
+        return 1;
+    }
+
+    if (RECIPE != "" && (EXECUTION_TYPE != "sequential" || COLOR_MODE != "rgb")) {
+        std::cout << "Recipes require the sequential execution type and the 'rgb' color mode." << std::endl;
+        return 1;
+    }
+
+    if (!PIPELINE.empty() && (EXECUTION_TYPE != "sequential" || COLOR_MODE != "rgb")) {
+        std::cout << "Pipelines require the sequential execution type and the 'rgb' color mode." << std::endl;
+        return 1;
+    }
+
+    if (GAUSSIAN_METHOD != Sequential::RECURSIVE_GAUSSIAN && SIGMA == 0) {
+        std::cout << "Gaussian methods require a '--sigma'." << std::endl;
+        return 1;
+    }
+
+    if (SIGMA > 0 && (EXECUTION_TYPE != "sequential" || COLOR_MODE != "rgb" || SAMPLE_TYPE != "uint8")) {
+        std::cout << "Gaussian blurs of any sigma require the sequential execution type, the 'rgb' color mode and the 'uint8' sample type." << std::endl;
+        return 1;
+    }
+
+    if (KERNEL_ITERATIONS > 1 && (EXECUTION_TYPE != "sequential" || COLOR_MODE != "rgb" || KERNEL == "" || SAMPLE_TYPE != "uint8")) {
+        std::cout << "Iterations require the sequential execution type, the 'rgb' color mode, the 'uint8' sample type and a '--kernel'." << std::endl;
+        return 1;
+    }
+
+    if (SAMPLE_TYPE != "uint8" && (EXECUTION_TYPE != "sequential" || COLOR_MODE != "rgb" || KERNEL == "")) {
+        std::cout << "Sample types other than 'uint8' require the sequential execution type, the 'rgb' color mode and a '--kernel'." << std::endl;
+        return 1;
+    }
+
     return 0;
 }
 
+// Create a kernel from its name.
+Kernel createKernel(const std::string& name) {
+    if (name == "box_blur") {
+        return Kernel::box_blur_kernel();
+    } else if (name == "gaussian_blur") {
+        return Kernel::gaussian_blur_kernel();
+    } else if (name == "sharpen") {
+        return Kernel::sharpen_kernel();
+    } else if (name == "edge_detection") {
+        return Kernel::edge_detection_kernel();
+    } else if (name == "unsharpen_mask") {
+        return Kernel::unsharpen_mask_kernel();
+    } else if (name == "emboss") {
+        return Kernel::emboss_kernel();
+    } else if (name == "custom" && KERNEL == "custom") {
+        return Kernel::custom_kernel(KERNEL_SIZE, KERNEL_DATA, KERNEL_NORMALIZATION);
+    }
+
+    std::cerr << "Error: Invalid kernel: " << name << "." << std::endl;
+    throw std::invalid_argument("Invalid kernel: " + name + ".");
+}
+
+// Save the convolved image, restoring the chroma of the original image in luma mode.
+void saveResult(const Image& image, const Image& result) {
+    if (!OUTPUT_PATH.empty()) {
+        if (COLOR_MODE == "luma") {
+            image.with_luma(result).save_image(OUTPUT_PATH.c_str());
+        } else {
+            result.save_image(OUTPUT_PATH.c_str());
+        }
+    }
+}
+
 // Run the convolution on the image with the kernel and save the result.
-void runConvolution(const Image& image, const Kernel& kernel) {
+void runConvolution(const Image& original_image, const Kernel& kernel) {
     // Print the kernel.
     if (VERBOSITY >= 1) std::cout << kernel << std::endl;
 
+    // Convolve the luma only in luma modes.
+    const Image image = (COLOR_MODE == "rgb") ? original_image : original_image.get_luma();
+
     // Run the convolution.
     if (EXECUTION_TYPE == "sequential") {
         // Run the sequential convolution.
-        Image result = Sequential::Convolution::convolve(image, kernel, PADDING_TYPE, RESULTS_PATH);
+        Image result = Sequential::Convolution::convolve(image, kernel, PADDING_TYPE, RESULTS_PATH, CHANNEL_MASK);
 
         // Save the convolved image.
-        if (!OUTPUT_PATH.empty()) {
-            result.save_image(OUTPUT_PATH.c_str());
-        }
+        saveResult(original_image, result);
     } else {
         // Run the parallel convolution.
         if (MEMORY_TYPE == "global") {
             // Run the global memory convolution.
-            Image result = Parallel::Convolution::convolve_global(image, kernel, PADDING_TYPE, RESULTS_PATH);
+            Image result = Parallel::Convolution::convolve_global(image, kernel, PADDING_TYPE, RESULTS_PATH, CHANNEL_MASK);
 
             // Save the convolved image.
-            if (!OUTPUT_PATH.empty()) {
-                result.save_image(OUTPUT_PATH.c_str());
-            }
+            saveResult(original_image, result);
         } else if (MEMORY_TYPE == "constant") {
             // Run the constant memory convolution.
-            Image result = Parallel::Convolution::convolve_constant(image, kernel, PADDING_TYPE, RESULTS_PATH);
+            Image result = Parallel::Convolution::convolve_constant(image, kernel, PADDING_TYPE, RESULTS_PATH, CHANNEL_MASK);
 
             // Save the convolved image.
-            if (!OUTPUT_PATH.empty()) {
-                result.save_image(OUTPUT_PATH.c_str());
-            }
+            saveResult(original_image, result);
         } else if (MEMORY_TYPE == "shared") {
             // Run the shared memory convolution.
-            Image result = Parallel::Convolution::convolve_shared(image, kernel, PADDING_TYPE, RESULTS_PATH);
+            Image result = Parallel::Convolution::convolve_shared(image, kernel, PADDING_TYPE, RESULTS_PATH, CHANNEL_MASK);
 
             // Save the convolved image.
-            if (!OUTPUT_PATH.empty()) {
-                result.save_image(OUTPUT_PATH.c_str());
-            }
+            saveResult(original_image, result);
         } else {
             // Run the pinned memory convolution.
-            Image result = Parallel::Convolution::convolve_pinned(image, kernel, PADDING_TYPE, RESULTS_PATH, 3);
+            Image result = Parallel::Convolution::convolve_pinned(image, kernel, PADDING_TYPE, RESULTS_PATH, 3, CHANNEL_MASK);
 
             // Save the convolved image.
-            if (!OUTPUT_PATH.empty()) {
-                result.save_image(OUTPUT_PATH.c_str());
-            }
+            saveResult(original_image, result);
         }
     }    
 }
 
 
+// Run the convolution on the image loaded with samples of type T and save the result.
+template <typename T>
+void runSampleConvolution() {
+    // Load the image and the kernel.
+    const BasicImage<T> image(IMAGE_PATH.c_str(), 0, SOA);
+    const Kernel kernel = createKernel(KERNEL);
+    if (VERBOSITY >= 1) std::cout << kernel << std::endl;
+
+    // Run the sequential convolution and save the convolved image.
+    const BasicImage<T> result = Sequential::Convolution::convolve_samples(image, kernel, PADDING_TYPE, RESULTS_PATH, CHANNEL_MASK);
+    if (!OUTPUT_PATH.empty()) { result.save_image(OUTPUT_PATH.c_str()); }
+}
+
+
 int main(int argc, char* argv[]) {
     // Process the input.
     if (processInput(argc, argv) != 0) {
         return 1;
     }
 
+    // Start the CPU threads.
+    ThreadPool::get_instance().configure(THREADS, PIN_THREADS);
+
+    // Force the instruction set of the CPU primitives if required.
+    if (ISA != "") { Isa::set_instruction_set(Isa::parse(ISA)); }
+    if (VERBOSITY >= 1) std::cout << "Instruction set: " << Isa::to_string(Isa::get_instruction_set()) << std::endl;
+
+    // Run the convolution on wider samples.
+    if (SAMPLE_TYPE != "uint8") {
+        if (SAMPLE_TYPE == "uint16") {
+            runSampleConvolution<uint16_t>();
+        } else if (SAMPLE_TYPE == "int16") {
+            runSampleConvolution<int16_t>();
+        } else {
+            runSampleConvolution<float>();
+        }
+
+        return 0;
+    }
+
     // Load the image.
     Image image(IMAGE_PATH.c_str(), 0, SOA);
 
-    // Load the kernel and run the convolution.
-    if (KERNEL == "box_blur") {
-        Kernel kernel = Kernel::box_blur_kernel();
-        runConvolution(image, kernel);
-    } else if (KERNEL == "gaussian_blur") {
-        Kernel kernel = Kernel::gaussian_blur_kernel();
-        runConvolution(image, kernel);
-    } else if (KERNEL == "sharpen") {
-        Kernel kernel = Kernel::sharpen_kernel();
-        runConvolution(image, kernel);
-    } else if (KERNEL == "edge_detection") {
-        Kernel kernel = Kernel::edge_detection_kernel();
-        runConvolution(image, kernel);
-    } else if (KERNEL == "unsharpen_mask") {
-        Kernel kernel = Kernel::unsharpen_mask_kernel();
-        runConvolution(image, kernel);
-    } else if (KERNEL == "emboss") {
-        Kernel kernel = Kernel::emboss_kernel();
-        runConvolution(image, kernel);
-    } else {
-        Kernel kernel = Kernel::custom_kernel(KERNEL_SIZE, KERNEL_DATA, KERNEL_NORMALIZATION);
-        runConvolution(image, kernel);
+    // Keep a single channel of grayscale images if required.
+    if (GRAYSCALE_OUTPUT && image.get_is_grayscale()) {
+        image = image.get_channel(0);
     }
 
+    // Run the convolution with a kernel per channel.
+    if (!CHANNEL_KERNELS.empty()) {
+        // Load the channel kernels.
+        std::vector<Kernel> kernels; // Loaded kernels.
+        for (const std::string& name : CHANNEL_KERNELS) {
+            if (name != "none") { kernels.push_back(createKernel(name)); }
+        }
+
+        // Point each channel to its kernel.
+        std::vector<const Kernel*> channel_kernels; // Kernel of each channel.
+        for (size_t channel = 0, k = 0; channel < CHANNEL_KERNELS.size(); channel++) {
+            channel_kernels.push_back((CHANNEL_KERNELS[channel] == "none") ? NULL : &kernels[k++]);
+        }
+
+        // Run the sequential convolution and save the convolved image.
+        Image result = Sequential::Convolution::convolve_channels(image, channel_kernels, PADDING_TYPE, RESULTS_PATH);
+        saveResult(image, result);
+
+        return 0;
+    }
+
+    // Run the convolution with a bank of kernels.
+    if (!FILTER_BANK.empty()) {
+        // Load the kernels.
+        std::vector<Kernel> kernels; // Loaded kernels.
+        for (const std::string& name : FILTER_BANK) {
+            kernels.push_back(createKernel(name));
+        }
+
+        // Run the filter bank convolution.
+        std::vector<Image> results = Sequential::Convolution::convolve_bank(image, kernels, PADDING_TYPE, RESULTS_PATH);
+
+        // Save each convolved image with the kernel name appended to the output file name.
+        if (!OUTPUT_PATH.empty()) {
+            const size_t extension = OUTPUT_PATH.find_last_of('.'); // Position of the file extension.
+            for (size_t k = 0; k < results.size(); k++) {
+                const std::string path = (extension == std::string::npos) ? (OUTPUT_PATH + "_" + FILTER_BANK[k]) : (OUTPUT_PATH.substr(0, extension) + "_" + FILTER_BANK[k] + OUTPUT_PATH.substr(extension));
+                results[k].save_image(path.c_str());
+            }
+        }
+
+        return 0;
+    }
+
+    // Evaluate an enhancement recipe in one fused pass.
+    if (RECIPE != "") {
+        using namespace Sequential;
+        const Kernel gaussian = Kernel::gaussian_blur_kernel(); // 3x3 gaussian blur.
+
+        Image result = (RECIPE == "unsharp")
+            ? evaluate(2.0f * term(image) - convolved(image, gaussian, PADDING_TYPE), RESULTS_PATH)
+            : evaluate(absolute(convolved(image, gaussian, PADDING_TYPE) - convolved(image, gaussian.compose(gaussian), PADDING_TYPE)) * 4.0f, RESULTS_PATH);
+        saveResult(image, result);
+
+        return 0;
+    }
+
+    // Blur with an approximated gaussian of any standard deviation.
+    if (SIGMA > 0) {
+        Image result = Sequential::Convolution::convolve_gaussian(image, SIGMA, PADDING_TYPE, RESULTS_PATH, CHANNEL_MASK, GAUSSIAN_METHOD);
+        saveResult(image, result);
+
+        return 0;
+    }
+
+    // Run the convolution with a chain of stages.
+    if (!PIPELINE.empty()) {
+        // Load the stages.
+        std::vector<Sequential::PipelineStage> stages; // Loaded stages.
+        std::vector<Kernel> kernels; // Kernels of the stages, when every stage is linear.
+        for (const std::string& name : PIPELINE) {
+            if (name == "median") {
+                stages.push_back(Sequential::PipelineStage::window(Sequential::PipelineStage::MEDIAN));
+            } else if (name == "erosion") {
+                stages.push_back(Sequential::PipelineStage::window(Sequential::PipelineStage::EROSION));
+            } else if (name == "dilation") {
+                stages.push_back(Sequential::PipelineStage::window(Sequential::PipelineStage::DILATION));
+            } else {
+                kernels.push_back(createKernel(name));
+                stages.push_back(Sequential::PipelineStage::convolution(kernels.back()));
+            }
+        }
+
+        // Collapse linear chains into one kernel, and fuse the other ones tile by tile.
+        Image result = (FUSED || kernels.size() < stages.size())
+            ? Sequential::Convolution::convolve_fused(image, stages, PADDING_TYPE, RESULTS_PATH, CHANNEL_MASK)
+            : Sequential::Convolution::convolve_pipeline(image, kernels, PADDING_TYPE, RESULTS_PATH, CHANNEL_MASK, SEPARABLE);
+        saveResult(image, result);
+
+        return 0;
+    }
+
+    // Load the kernel.
+    Kernel kernel = createKernel(KERNEL);
+
+    // Run the repeated applications of the kernel tile by tile.
+    if (KERNEL_ITERATIONS > 1) {
+        Image result = Sequential::Convolution::convolve_iterated(image, kernel, KERNEL_ITERATIONS, PADDING_TYPE, RESULTS_PATH, CHANNEL_MASK);
+        saveResult(image, result);
+
+        return 0;
+    }
+
+    // Tune the convolution, or get its cached (or heuristic) configuration.
+    const TuningConfig config = TUNE ? Tuner::tune(EXECUTION_TYPE, image, kernel, PADDING_TYPE, CHANNEL_MASK) : Tuner::get_config(EXECUTION_TYPE, image, kernel);
+
+    // Apply the configuration to the settings not given as arguments.
+    if (!SOA && !AOS) { image.set_is_SoA(config.is_SoA); }
+    if (MEMORY_TYPE.empty()) { MEMORY_TYPE = config.memory_type; }
+    Sequential::Convolution::set_band_size(config.band_size);
+
+    // Run the convolution.
+    runConvolution(image, kernel);
+
     return 0;
 }
\ No newline at end of file
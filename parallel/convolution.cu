@@ -66,7 +66,7 @@ __device__ void set_pixel_value(uint8_t* d_input, const int col, const int row,
 __global__ void convolution_kernel_global(uint8_t* d_input, float* d_kernel, uint8_t* d_output,
                                    int width, int height, int channels,
                                    int kernel_width, int kernel_height,
-                                   int padding_width, int padding_height, bool is_SoA)
+                                   int padding_width, int padding_height, bool is_SoA, uint32_t channel_mask)
 {
     // Calculate the global index in the output image.
     const int x = blockIdx.x * blockDim.x + threadIdx.x; // Column index.
@@ -80,6 +80,12 @@ __global__ void convolution_kernel_global(uint8_t* d_input, float* d_kernel, uin
     // Check if the thread is within the image bounds.
     if(x < width && y < height) {
         for(int channel = 0; channel < channels; channel++) {
+            // Copy the channels not to be convolved through.
+            if (channel < 32 && !((channel_mask >> channel) & 1)) {
+                set_pixel_value(d_output, x, y, channel, width, height, channels, is_SoA, get_pixel_value(d_input, x + padding_width, y + padding_height, channel, padded_width, padded_height, channels, is_SoA));
+                continue;
+            }
+
             // Output value for the current pixel.
             float output_value = 0.0f;
 
@@ -105,7 +111,7 @@ __global__ void convolution_kernel_global(uint8_t* d_input, float* d_kernel, uin
 __global__ void convolution_kernel_constant(uint8_t* d_input, uint8_t* d_output,
                                    int width, int height, int channels,
                                    int kernel_width, int kernel_height,
-                                   int padding_width, int padding_height, bool is_SoA)
+                                   int padding_width, int padding_height, bool is_SoA, uint32_t channel_mask)
 {
     // Calculate the global index in the output image.
     const int x = blockIdx.x * blockDim.x + threadIdx.x; // Column index.
@@ -119,6 +125,12 @@ __global__ void convolution_kernel_constant(uint8_t* d_input, uint8_t* d_output,
     // Check if the thread is within the image bounds.
     if(x < width && y < height) {
         for(int channel = 0; channel < channels; channel++) {
+            // Copy the channels not to be convolved through.
+            if (channel < 32 && !((channel_mask >> channel) & 1)) {
+                set_pixel_value(d_output, x, y, channel, width, height, channels, is_SoA, get_pixel_value(d_input, x + padding_width, y + padding_height, channel, padded_width, padded_height, channels, is_SoA));
+                continue;
+            }
+
             // Output value for the current pixel.
             float output_value = 0.0f;
 
@@ -146,7 +158,7 @@ __global__ void convolution_kernel_constant(uint8_t* d_input, uint8_t* d_output,
 __global__ void convolution_kernel_shared(uint8_t* d_input, uint8_t* d_output,
                                    int width, int height, int channels,
                                    int kernel_width, int kernel_height,
-                                   int padding_width, int padding_height, bool is_SoA)
+                                   int padding_width, int padding_height, bool is_SoA, uint32_t channel_mask)
 {
     // Shared memory for the input image tile (dynamically sized by kernel launcher).
 	extern __shared__ uint8_t s_data[];
@@ -163,6 +175,16 @@ __global__ void convolution_kernel_shared(uint8_t* d_input, uint8_t* d_output,
     const int num_entire_batches = floor((float)s_width * s_height / (TILE_WIDTH * TILE_WIDTH)); // Number of entire batches.
 
     for(int channel = 0; channel < channels; channel++) {
+        // Copy the channels not to be convolved through (the mask is uniform across the block, so the synchronisation below is not skipped by part of it).
+        if (channel < 32 && !((channel_mask >> channel) & 1)) {
+            const int x = blockIdx.x * TILE_WIDTH + threadIdx.x; // Column index.
+            const int y = blockIdx.y * TILE_WIDTH + threadIdx.y; // Row index.
+            if (x < width && y < height) {
+                set_pixel_value(d_output, x, y, channel, width, height, channels, is_SoA, get_pixel_value(d_input, x + padding_width, y + padding_height, channel, padded_width, padded_height, channels, is_SoA));
+            }
+            continue;
+        }
+
         for(int i = 0; i < num_entire_batches; i++) {
             /*Loading firsts (TILE_WIDTH * TILE_WIDTH) elements into shared memory.*/
 
@@ -247,7 +269,7 @@ __global__ void convolution_kernel_shared(uint8_t* d_input, uint8_t* d_output,
 
 // Methods.
 
-Image Parallel::Convolution::convolve_global(const Image& image, const Kernel& kernel, const PaddingType padding_type, const std::string results_path) {
+Image Parallel::Convolution::convolve_global(const Image& image, const Kernel& kernel, const PaddingType padding_type, const std::string results_path, const uint32_t channel_mask) {
     // Input image dimensions.
     const int width = image.get_width(); // Input image width.
     const int height = image.get_height(); // Input image height.
@@ -261,7 +283,7 @@ Image Parallel::Convolution::convolve_global(const Image& image, const Kernel& k
     // Apply padding to the input image.
     const int padding_width = floor((float)kernel_width / 2); // Padding width.
     const int padding_height = floor((float)kernel_height / 2); // Padding height.
-    Image padded_image = image.padding(padding_width, padding_height, padding_type); // Padded image.
+    const Image padded_image = image.padding(padding_width, padding_height, padding_type); // Padded image.
 
     // Padded image dimensions.
     const int padded_width = padded_image.get_width(); // Padded image width.
@@ -276,9 +298,9 @@ Image Parallel::Convolution::convolve_global(const Image& image, const Kernel& k
     
 
     // Host memory pointers.
-    uint8_t* h_input = padded_image.get_data(); // Input image data.
+    const uint8_t* h_input = padded_image.get_data(); // Input image data.
     uint8_t* h_output = (uint8_t*)malloc(output_size); // Output image data.
-    float* h_kernel = kernel.get_data(); // Kernel data.
+    const float* h_kernel = kernel.get_data(); // Kernel data.
 
     // Device memory pointers.
     uint8_t* d_input; // Input image data.
@@ -320,7 +342,7 @@ Image Parallel::Convolution::convolve_global(const Image& image, const Kernel& k
         CUDA_CHECK_RETURN(cudaEventRecord(start));
 
         // Launch kernel.
-        convolution_kernel_global<<<gridDim, blockDim>>>(d_input, d_kernel, d_output, width, height, channels, kernel_width, kernel_height, padding_width, padding_height, image.get_is_SoA());
+        convolution_kernel_global<<<gridDim, blockDim>>>(d_input, d_kernel, d_output, width, height, channels, kernel_width, kernel_height, padding_width, padding_height, image.get_is_SoA(), channel_mask);
         
         // End iteration execution time.
         CUDA_CHECK_RETURN(cudaEventRecord(stop));
@@ -371,7 +393,7 @@ Image Parallel::Convolution::convolve_global(const Image& image, const Kernel& k
     return Image(width, height, channels, h_output, image.get_is_SoA());
 }
 
-Image Parallel::Convolution::convolve_constant(const Image &image, const Kernel &kernel, const PaddingType padding_type, const std::string results_path) {
+Image Parallel::Convolution::convolve_constant(const Image &image, const Kernel &kernel, const PaddingType padding_type, const std::string results_path, const uint32_t channel_mask) {
     // Input image dimensions.
     const int width = image.get_width(); // Input image width.
     const int height = image.get_height(); // Input image height.
@@ -385,7 +407,7 @@ Image Parallel::Convolution::convolve_constant(const Image &image, const Kernel
     // Apply padding to the input image.
     const int padding_width = floor((float)kernel_width / 2); // Padding width.
     const int padding_height = floor((float)kernel_height / 2); // Padding height.
-    Image padded_image = image.padding(padding_width, padding_height, padding_type); // Padded image.
+    const Image padded_image = image.padding(padding_width, padding_height, padding_type); // Padded image.
 
     // Padded image dimensions.
     const int padded_width = padded_image.get_width(); // Padded image width.
@@ -400,9 +422,9 @@ Image Parallel::Convolution::convolve_constant(const Image &image, const Kernel
     
 
     // Host memory pointers.
-    uint8_t* h_input = padded_image.get_data(); // Input image data.
+    const uint8_t* h_input = padded_image.get_data(); // Input image data.
     uint8_t* h_output = (uint8_t*)malloc(output_size); // Output image data.
-    float* h_kernel = kernel.get_data(); // Kernel data.
+    const float* h_kernel = kernel.get_data(); // Kernel data.
 
     // Device memory pointers.
     uint8_t* d_input; // Input image data.
@@ -444,7 +466,7 @@ Image Parallel::Convolution::convolve_constant(const Image &image, const Kernel
         CUDA_CHECK_RETURN(cudaEventRecord(start));
 
         // Launch kernel.
-        convolution_kernel_constant<<<gridDim, blockDim>>>(d_input, d_output, width, height, channels, kernel_width, kernel_height, padding_width, padding_height, image.get_is_SoA());
+        convolution_kernel_constant<<<gridDim, blockDim>>>(d_input, d_output, width, height, channels, kernel_width, kernel_height, padding_width, padding_height, image.get_is_SoA(), channel_mask);
         
         // End iteration execution time.
         CUDA_CHECK_RETURN(cudaEventRecord(stop));
@@ -494,7 +516,7 @@ Image Parallel::Convolution::convolve_constant(const Image &image, const Kernel
     return Image(width, height, channels, h_output, image.get_is_SoA());
 }
 
-Image Parallel::Convolution::convolve_shared(const Image &image, const Kernel &kernel, const PaddingType padding_type, const std::string results_path) {
+Image Parallel::Convolution::convolve_shared(const Image &image, const Kernel &kernel, const PaddingType padding_type, const std::string results_path, const uint32_t channel_mask) {
     // Input image dimensions.
     const int width = image.get_width(); // Input image width.
     const int height = image.get_height(); // Input image height.
@@ -508,7 +530,7 @@ Image Parallel::Convolution::convolve_shared(const Image &image, const Kernel &k
     // Apply padding to the input image.
     const int padding_width = floor((float)kernel_width / 2); // Padding width.
     const int padding_height = floor((float)kernel_height / 2); // Padding height.
-    Image padded_image = image.padding(padding_width, padding_height, padding_type); // Padded image.
+    const Image padded_image = image.padding(padding_width, padding_height, padding_type); // Padded image.
 
     // Padded image dimensions.
     const int padded_width = padded_image.get_width(); // Padded image width.
@@ -524,9 +546,9 @@ Image Parallel::Convolution::convolve_shared(const Image &image, const Kernel &k
     
 
     // Host memory pointers.
-    uint8_t* h_input = padded_image.get_data(); // Input image data.
+    const uint8_t* h_input = padded_image.get_data(); // Input image data.
     uint8_t* h_output = (uint8_t*)malloc(output_size); // Output image data.
-    float* h_kernel = kernel.get_data(); // Kernel data.
+    const float* h_kernel = kernel.get_data(); // Kernel data.
 
     // Device memory pointers.
     uint8_t* d_input; // Input image data.
@@ -568,7 +590,7 @@ Image Parallel::Convolution::convolve_shared(const Image &image, const Kernel &k
         CUDA_CHECK_RETURN(cudaEventRecord(start));
 
         // Launch kernel.
-        convolution_kernel_shared<<<gridDim, blockDim, shared_size>>>(d_input, d_output, width, height, channels, kernel_width, kernel_height, padding_width, padding_height, image.get_is_SoA());
+        convolution_kernel_shared<<<gridDim, blockDim, shared_size>>>(d_input, d_output, width, height, channels, kernel_width, kernel_height, padding_width, padding_height, image.get_is_SoA(), channel_mask);
 
         // End iteration execution time.
         CUDA_CHECK_RETURN(cudaEventRecord(stop));
@@ -618,7 +640,7 @@ Image Parallel::Convolution::convolve_shared(const Image &image, const Kernel &k
     return Image(width, height, channels, h_output, image.get_is_SoA());
 }
 
-Image Parallel::Convolution::convolve_pinned(const Image &image, const Kernel &kernel, const PaddingType padding_type, const std::string results_path, const int stream_count) {
+Image Parallel::Convolution::convolve_pinned(const Image &image, const Kernel &kernel, const PaddingType padding_type, const std::string results_path, const int stream_count, const uint32_t channel_mask) {
     // Input image dimensions.
     const int width = image.get_width(); // Input image width.
     const int height = image.get_height(); // Input image height.
@@ -632,7 +654,7 @@ Image Parallel::Convolution::convolve_pinned(const Image &image, const Kernel &k
     // Apply padding to the input image.
     const int padding_width = floor((float)kernel_width / 2); // Padding width.
     const int padding_height = floor((float)kernel_height / 2); // Padding height.
-    Image padded_image = image.padding(padding_width, padding_height, padding_type); // Padded image.
+    const Image padded_image = image.padding(padding_width, padding_height, padding_type); // Padded image.
 
     // Padded image dimensions.
     const int padded_width = padded_image.get_width(); // Padded image width.
@@ -648,9 +670,9 @@ Image Parallel::Convolution::convolve_pinned(const Image &image, const Kernel &k
 
 
     // Pageable host memory pointers.
-    uint8_t* h_input = padded_image.get_data(); // Input image data.
+    const uint8_t* h_input = padded_image.get_data(); // Input image data.
     uint8_t* h_output = (uint8_t*)malloc(output_size); // Output image data.
-    float* h_kernel = kernel.get_data(); // Kernel data.
+    const float* h_kernel = kernel.get_data(); // Kernel data.
 
     // Pinned host memory pointers.
     uint8_t* h_pinned_input; // Input image data.
@@ -715,7 +737,7 @@ Image Parallel::Convolution::convolve_pinned(const Image &image, const Kernel &k
             CUDA_CHECK_RETURN(cudaMemcpyAsync(d_input + input_offset, h_pinned_input + input_offset, input_stream_size, cudaMemcpyHostToDevice, streams[n]));
 
             // Launch kernel.
-            convolution_kernel_shared<<<gridDim, blockDim, shared_size, streams[n]>>>(d_input + input_offset, d_output, width, height, channels, kernel_width, kernel_height, padding_width, padding_height, image.get_is_SoA());
+            convolution_kernel_shared<<<gridDim, blockDim, shared_size, streams[n]>>>(d_input + input_offset, d_output, width, height, channels, kernel_width, kernel_height, padding_width, padding_height, image.get_is_SoA(), channel_mask);
 
             // Copy output data from device global memory to pinned host memory asynchronously.
             CUDA_CHECK_RETURN(cudaMemcpyAsync(h_pinned_output, d_output, output_size, cudaMemcpyDeviceToHost, streams[n]));
@@ -780,3 +802,73 @@ Image Parallel::Convolution::convolve_pinned(const Image &image, const Kernel &k
     // Create the output image.
     return Image(width, height, channels, h_output, image.get_is_SoA());
 }
+
+
+// Plan.
+
+Parallel::ConvolutionPlan::ConvolutionPlan(const int width, const int height, const int channels, const bool is_SoA, const Kernel& kernel, const PaddingType padding_type, const uint32_t channel_mask)
+    : width(width), height(height), channels(channels), is_SoA(is_SoA), kernel_width(kernel.get_width()), kernel_height(kernel.get_height()),
+      padding_type(padding_type), channel_mask(channel_mask), padded_image(1, 1, 1) {
+    // Compute the padding index tables.
+    const int padding_width = floor((float)kernel_width / 2); // Padding width.
+    const int padding_height = floor((float)kernel_height / 2); // Padding height.
+    column_table = Image::padding_table(width, padding_width, padding_type);
+    row_table = Image::padding_table(height, padding_height, padding_type);
+
+    // Allocate the padded image and page-lock it.
+    padded_image = Image::uninitialized(width + 2 * padding_width, height + 2 * padding_height, channels, is_SoA);
+    CUDA_CHECK_RETURN(cudaHostRegister(padded_image.get_data(), padded_image.get_size() * sizeof(uint8_t), cudaHostRegisterDefault));
+
+    // Sizes in bytes.
+    const size_t input_size = padded_image.get_size() * sizeof(uint8_t); // Input image size.
+    const size_t output_size = (size_t)width * height * channels * sizeof(uint8_t); // Output image size.
+    const size_t kernel_size = (size_t)kernel_width * kernel_height * sizeof(float); // Kernel size.
+
+    // Allocate device memory and upload the kernel.
+    CUDA_CHECK_RETURN(cudaMalloc((void**)&d_input, input_size));
+    CUDA_CHECK_RETURN(cudaMalloc((void**)&d_output, output_size));
+    CUDA_CHECK_RETURN(cudaMalloc((void**)&d_kernel, kernel_size));
+    CUDA_CHECK_RETURN(cudaMemcpy(d_kernel, kernel.get_data(), kernel_size, cudaMemcpyHostToDevice));
+
+    // Create the stream.
+    CUDA_CHECK_RETURN(cudaStreamCreate(&stream));
+}
+
+Parallel::ConvolutionPlan::~ConvolutionPlan() {
+    // Clean up the stream and the memory.
+    CUDA_CHECK_RETURN(cudaStreamDestroy(stream));
+    CUDA_CHECK_RETURN(cudaFree(d_input));
+    CUDA_CHECK_RETURN(cudaFree(d_output));
+    CUDA_CHECK_RETURN(cudaFree(d_kernel));
+    CUDA_CHECK_RETURN(cudaHostUnregister(padded_image.get_data()));
+}
+
+void Parallel::ConvolutionPlan::execute(const Image& input, Image& output) {
+    // Check if the input image matches the plan.
+    if (input.get_width() != width || input.get_height() != height || input.get_channels() != channels || input.get_is_SoA() != is_SoA) {
+        std::cerr << "Error: The image does not match the convolution plan." << std::endl;
+        throw std::invalid_argument("Invalid image for the convolution plan.");
+    }
+
+    // Reallocate the output image only if needed.
+    if (output.get_width() != width || output.get_height() != height || output.get_channels() != channels || output.get_is_SoA() != is_SoA) {
+        output = Image::uninitialized(width, height, channels, is_SoA);
+    }
+
+    // Pad the input into the page-locked scratch image (the registered buffer is never shared, so it is written in place).
+    input.padding_into(padded_image, column_table, row_table, padding_type);
+
+    // Specify block and grid dimensions.
+    dim3 blockDim(TILE_WIDTH, TILE_WIDTH); // Threads per block.
+    dim3 gridDim((width + blockDim.x - 1) / blockDim.x, (height + blockDim.y - 1) / blockDim.y); // Blocks per grid.
+
+    // Copy the input, launch the kernel and copy the output back on the plan stream.
+    const int padding_width = (padded_image.get_width() - width) / 2; // Padding width.
+    const int padding_height = (padded_image.get_height() - height) / 2; // Padding height.
+    CUDA_CHECK_RETURN(cudaMemcpyAsync(d_input, padded_image.get_data(), padded_image.get_size() * sizeof(uint8_t), cudaMemcpyHostToDevice, stream));
+    convolution_kernel_global<<<gridDim, blockDim, 0, stream>>>(d_input, d_kernel, d_output, width, height, channels, kernel_width, kernel_height, padding_width, padding_height, is_SoA, channel_mask);
+    CUDA_CHECK_RETURN(cudaMemcpyAsync(output.get_data(), d_output, output.get_size() * sizeof(uint8_t), cudaMemcpyDeviceToHost, stream));
+
+    // Wait for the execution to finish.
+    CUDA_CHECK_RETURN(cudaStreamSynchronize(stream));
+}
@@ -1,10 +1,17 @@
 #ifndef CONVOLUTION_PARALLEL_H
 #define CONVOLUTION_PARALLEL_H
 
+#include <string>
+#include <vector>
+
 #include "../image.h"
 #include "../kernel.h"
 
 
+// CUDA stream (cudaStream_t).
+struct CUstream_st;
+
+
 namespace Parallel {
     class Convolution {
         public:
@@ -15,10 +22,11 @@ namespace Parallel {
                 * @param kernel The kernel to be applied.
                 * @param padding_type The type of padding to be applied.
                 * @param results_path The path to save the results.
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
                 * 
                 * @return The convolved image.
             */
-            static Image convolve_global(const Image& image, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO, const std::string results_path = "");
+            static Image convolve_global(const Image& image, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO, const std::string results_path = "", const uint32_t channel_mask = ALL_CHANNELS);
     
             /*
                 * Applies convolution to an image using a kernel in constant memory.
@@ -27,10 +35,11 @@ namespace Parallel {
                 * @param kernel The kernel to be applied.
                 * @param padding_type The type of padding to be applied.
                 * @param results_path The path to save the results.
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
                 * 
                 * @return The convolved image.
             */
-            static Image convolve_constant(const Image& image, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO, const std::string results_path = "");
+            static Image convolve_constant(const Image& image, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO, const std::string results_path = "", const uint32_t channel_mask = ALL_CHANNELS);
     
             /*
                 * Applies convolution to an image using a kernel in shared memory.
@@ -39,10 +48,11 @@ namespace Parallel {
                 * @param kernel The kernel to be applied.
                 * @param padding_type The type of padding to be applied.
                 * @param results_path The path to save the results.
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
                 * 
                 * @return The convolved image.
             */
-            static Image convolve_shared(const Image& image, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO, const std::string results_path = "");
+            static Image convolve_shared(const Image& image, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO, const std::string results_path = "", const uint32_t channel_mask = ALL_CHANNELS);
 
             /*
                 * Applies convolution to an image using a kernel in shared memory and pinned memory.
@@ -52,10 +62,81 @@ namespace Parallel {
                 * @param padding_type The type of padding to be applied.
                 * @param results_path The path to save the results.
                 * @param stream_count The number of streams to be used.
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
                 * 
                 * @return The convolved image.
             */
-            static Image convolve_pinned(const Image& image, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO, const std::string results_path = "", const int stream_count = 1);
+            static Image convolve_pinned(const Image& image, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO, const std::string results_path = "", const int stream_count = 1, const uint32_t channel_mask = ALL_CHANNELS);
+    };
+
+    class ConvolutionPlan {
+        public:
+            // Constructors and destructor.
+
+            /*
+                * Plan the convolution of images with fixed dimensions and architecture using a kernel in global memory: the padding
+                * index tables, the page-locked padded image, the device buffers, the kernel upload and the stream are set up once.
+                *
+                * @param width The width of the images.
+                * @param height The height of the images.
+                * @param channels The number of channels of the images.
+                * @param is_SoA Whether the images are in SoA architecture.
+                * @param kernel The kernel to be applied.
+                * @param padding_type The padding type to be applied.
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
+            */
+            ConvolutionPlan(const int width, const int height, const int channels, const bool is_SoA, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO, const uint32_t channel_mask = ALL_CHANNELS);
+
+            // The plan owns device memory: plans are not copyable.
+            ConvolutionPlan(const ConvolutionPlan&) = delete;
+            ConvolutionPlan& operator=(const ConvolutionPlan&) = delete;
+
+            /*
+                * Destructor.
+            */
+            ~ConvolutionPlan();
+
+
+            // Methods.
+
+            /*
+                * Convolve an image with the planned dimensions and architecture.
+                *
+                * @param input The image to be convolved.
+                * @param output The output image (reallocated only if its dimensions or architecture differ).
+            */
+            void execute(const Image& input, Image& output);
+
+
+        private:
+            // Image dimensions.
+            int width, height, channels;
+
+            // Image architecture.
+            bool is_SoA;
+
+            // Kernel dimensions.
+            int kernel_width, kernel_height;
+
+            // Padding type.
+            PaddingType padding_type;
+
+            // Convolved channels.
+            uint32_t channel_mask;
+
+            // Source column of every padded column and source row of every padded row.
+            std::vector<int> column_table, row_table;
+
+            // Scratch padded image (page-locked for asynchronous copies).
+            Image padded_image;
+
+            // Device memory pointers.
+            uint8_t* d_input = NULL;
+            uint8_t* d_output = NULL;
+            float* d_kernel = NULL;
+
+            // CUDA stream of the executions.
+            CUstream_st* stream = NULL;
     };
 }
 
@@ -1,4 +1,14 @@
 #define ITERATIONS 15 // Number of iterations to execute the algorithm.
 #define VERBOSITY 2 // Verbosity level (0 = no verbosity, 1 = print results, 2 = print execution information and results).
 #define TILE_WIDTH 16 // Tile width for the GPU kernel (number of threads per block).
-#define MAX_MASK_WIDTH 10 // Maximum mask width for the GPU kernel (constant memory size).
\ No newline at end of file
+#define MAX_MASK_WIDTH 10 // Maximum mask width for the GPU kernel (constant memory size).
+#define BAND_SIZE 65536 // Size in bytes of the row bands processed by each CPU thread.
+#define DENSE_MIN_DENSITY 0.6f // Kernel density (fraction of non-zero taps) from which kernels are dense: mid-size dense kernels run on the direct engine and dense filter banks as a matrix product (the other kernels iterate over their non-zero taps).
+#define TUNING_CACHE_PATH "tuning_cache.txt" // Path of the auto-tuner cache file.
+#define TUNING_RUNS 3 // Timed runs of each auto-tuner candidate (after an untimed warm-up run), of which the fastest one is kept.
+#define GEMM_MIN_KERNELS 8 // Number of kernels from which dense filter banks are convolved as a matrix product (im2col + GEMM).
+#define FUSED_TILE_SIZE 64 // Size of the square output tiles of the fused pipelines (their intermediate tiles stay in the L2 cache).
+#define DIRECT_MIN_SIZE 9 // Size (at least 4) from which dense kernels are convolved by the register blocked direct engine.
+#define USE_JIT 1 // Whether the sequential convolution runs kernels compiled into machine code (x86-64 Linux, SSE4.2 and AVX2 instruction sets).
+#define ITERATED_TILE_SIZE 512 // Size of the square output tiles of the iterated convolution (the intermediate tiles of every application stay in the L2 cache).
+#define BOX_PASSES 3 // Number of successive box blurs (3 to 5) approximating a gaussian in the box method (more passes are closer to the gaussian but slower).
@@ -1,35 +1,812 @@
 #include <iostream>
 #include <chrono>
 #include <string>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <type_traits>
+#include <complex>
 
 #include "convolution.h"
+#include "expression.h"
+#include "jit.h"
 #include "../params.h"
 #include "../utils.h"
+#include "../thread_pool.h"
+#include "../isa.h"
 
-#define clamp(start, x, end) std::min(std::max(start, x), end)
+#if ISA_DISPATCH
+#include <immintrin.h>
+#endif
+
+
+// Helpers.
+
+// Convolve a row of a channel plane with the non-zero kernel taps only (input points to the padded pixel of the first output pixel).
+// The mirrored input samples of each symmetric tap group are added before being multiplied by their shared weight
+// (in integer arithmetic for integer samples). The folded sums round differently from one product per tap in row-major order,
+// so the outputs may differ by one level (±1) from the unfolded engines where a value falls next to a rounding boundary.
+template <typename T>
+static ISA_INLINE void taps_row_body(const T* input, const int padded_width, const std::vector<KernelTapGroup>& tap_groups, float* values, const int width) {
+    typedef typename std::conditional<std::is_integral<T>::value, int, float>::type Sum; // Type of the sums of samples.
+    std::fill(values, values + width, 0.0f);
+
+    // Each tap group adds its shifted input rows to the output values.
+    for (const KernelTapGroup& group : tap_groups) {
+        const int count = (int)group.offsets.size(); // Number of taps in the group.
+        const float weight = group.weight; // Shared weight.
+
+        // Shifted input rows of the taps.
+        const T* source[8];
+        for (int i = 0; i < count && i < 8; i++) {
+            source[i] = input + (ptrdiff_t)group.offsets[i].second * padded_width + group.offsets[i].first;
+        }
+
+        if (count == 1) {
+            const T* s0 = source[0];
+            #pragma omp simd
+            for (int x = 0; x < width; x++) { values[x] += weight * s0[x]; }
+        } else if (count == 2) {
+            const T *s0 = source[0], *s1 = source[1];
+            #pragma omp simd
+            for (int x = 0; x < width; x++) { values[x] += weight * (Sum)(s0[x] + s1[x]); }
+        } else if (count == 4) {
+            const T *s0 = source[0], *s1 = source[1], *s2 = source[2], *s3 = source[3];
+            #pragma omp simd
+            for (int x = 0; x < width; x++) { values[x] += weight * (Sum)(s0[x] + s1[x] + s2[x] + s3[x]); }
+        } else if (count == 8) {
+            const T *s0 = source[0], *s1 = source[1], *s2 = source[2], *s3 = source[3];
+            const T *s4 = source[4], *s5 = source[5], *s6 = source[6], *s7 = source[7];
+            #pragma omp simd
+            for (int x = 0; x < width; x++) { values[x] += weight * (Sum)(s0[x] + s1[x] + s2[x] + s3[x] + s4[x] + s5[x] + s6[x] + s7[x]); }
+        } else {
+            for (const std::pair<int, int>& offset : group.offsets) {
+                const T* s0 = input + (ptrdiff_t)offset.second * padded_width + offset.first;
+                #pragma omp simd
+                for (int x = 0; x < width; x++) { values[x] += weight * s0[x]; }
+            }
+        }
+    }
+}
+
+#if ISA_DISPATCH
+template <typename T>
+static ISA_TARGET_SSE4_2 void taps_row_sse4_2(const T* input, const int padded_width, const std::vector<KernelTapGroup>& tap_groups, float* values, const int width) {
+    taps_row_body(input, padded_width, tap_groups, values, width);
+}
+
+template <typename T>
+static ISA_TARGET_AVX2 void taps_row_avx2(const T* input, const int padded_width, const std::vector<KernelTapGroup>& tap_groups, float* values, const int width) {
+    taps_row_body(input, padded_width, tap_groups, values, width);
+}
+
+template <typename T>
+static ISA_TARGET_AVX512 void taps_row_avx512(const T* input, const int padded_width, const std::vector<KernelTapGroup>& tap_groups, float* values, const int width) {
+    taps_row_body(input, padded_width, tap_groups, values, width);
+}
+#endif
+
+// Convolve a row with the variant of the active instruction set.
+template <typename T>
+static void taps_row(const T* input, const int padded_width, const std::vector<KernelTapGroup>& tap_groups, float* values, const int width) {
+    switch (Isa::get_instruction_set()) {
+#if ISA_DISPATCH
+        case InstructionSet::AVX512: taps_row_avx512(input, padded_width, tap_groups, values, width); break;
+        case InstructionSet::AVX2: taps_row_avx2(input, padded_width, tap_groups, values, width); break;
+        case InstructionSet::SSE4_2: taps_row_sse4_2(input, padded_width, tap_groups, values, width); break;
+#endif
+        default: taps_row_body(input, padded_width, tap_groups, values, width);
+    }
+}
+
+// Convolve a row with the compiled row function of the kernel, if any (the pixels of its last partial iteration are left to the row
+// primitives of the active instruction set).
+static void compiled_row(const Sequential::JitRow& jit_row, const uint8_t* input, const int padded_width, const std::vector<KernelTapGroup>& tap_groups, float* values, const int width) {
+    const int jit_width = (jit_row.function != NULL) ? width - width % jit_row.pixels : 0; // Pixels of the compiled row function.
+    if (jit_width > 0) { jit_row.function(input, values, jit_width); }
+    taps_row(input + jit_width, padded_width, tap_groups, values + jit_width, width - jit_width);
+}
+
+#if ISA_DISPATCH
+static const int DIRECT_ROWS = 4; // Output rows of the register blocks of the direct engine (kernels are at least as tall).
+static const int DIRECT_SLACK = 64; // Samples readable past the end of the converted rows (the widest register tile).
+
+// Register vectors of the direct engine (vector instruction sets only), with the number of vectors per output row of its register tile.
+// They are passed by reference, so that they are only handled by the variants flattened for their instruction set.
+struct Sse42Vectors {
+    typedef __m128 Vector;
+    static const int LANES = 4, VECTORS = 2;
+    static ISA_TARGET_SSE4_2 inline void load(Vector& vector, const float* source) { vector = _mm_loadu_ps(source); }
+    static ISA_TARGET_SSE4_2 inline void broadcast(Vector& vector, const float value) { vector = _mm_set1_ps(value); }
+    static ISA_TARGET_SSE4_2 inline void multiply_add(Vector& accumulator, const Vector& a, const Vector& b) { accumulator = _mm_add_ps(_mm_mul_ps(a, b), accumulator); }
+    static ISA_TARGET_SSE4_2 inline void store(float* destination, const Vector& vector) { _mm_storeu_ps(destination, vector); }
+};
+
+struct Avx2Vectors {
+    typedef __m256 Vector;
+    static const int LANES = 8, VECTORS = 3;
+    static ISA_TARGET_AVX2 inline void load(Vector& vector, const float* source) { vector = _mm256_loadu_ps(source); }
+    static ISA_TARGET_AVX2 inline void broadcast(Vector& vector, const float value) { vector = _mm256_set1_ps(value); }
+    static ISA_TARGET_AVX2 inline void multiply_add(Vector& accumulator, const Vector& a, const Vector& b) { accumulator = _mm256_fmadd_ps(a, b, accumulator); }
+    static ISA_TARGET_AVX2 inline void store(float* destination, const Vector& vector) { _mm256_storeu_ps(destination, vector); }
+};
+
+struct Avx512Vectors {
+    typedef __m512 Vector;
+    static const int LANES = 16, VECTORS = 4;
+    static ISA_TARGET_AVX512 inline void load(Vector& vector, const float* source) { vector = _mm512_loadu_ps(source); }
+    static ISA_TARGET_AVX512 inline void broadcast(Vector& vector, const float value) { vector = _mm512_set1_ps(value); }
+    static ISA_TARGET_AVX512 inline void multiply_add(Vector& accumulator, const Vector& a, const Vector& b) { accumulator = _mm512_fmadd_ps(a, b, accumulator); }
+    static ISA_TARGET_AVX512 inline void store(float* destination, const Vector& vector) { _mm512_storeu_ps(destination, vector); }
+};
+
+// Accumulate an input row into the output rows [FIRST, LAST] of a register tile: each sample vector is loaded once per kernel column
+// and multiplied by the kernel row of every output row (weights points to the kernel row of output row 0).
+template <typename V, int FIRST, int LAST>
+static ISA_INLINE void direct_accumulate(typename V::Vector (&accumulators)[DIRECT_ROWS][V::VECTORS], const float* input, const float* weights, const int kernel_width) {
+    for (int kx = 0; kx < kernel_width; kx++) {
+        typename V::Vector samples[V::VECTORS]; // Input samples of the tile.
+        for (int v = 0; v < V::VECTORS; v++) { V::load(samples[v], input + kx + v * V::LANES); }
+
+        for (int r = FIRST; r <= LAST; r++) {
+            typename V::Vector weight; // Weight of the kernel row of output row r.
+            V::broadcast(weight, weights[kx - r * kernel_width]);
+            for (int v = 0; v < V::VECTORS; v++) { V::multiply_add(accumulators[r][v], weight, samples[v]); }
+        }
+    }
+}
+
+// Convolve a block of DIRECT_ROWS output rows with a dense kernel, a register tile of output columns at a time (rows holds the
+// kernel_height + DIRECT_ROWS - 1 converted input rows of the block, from the top-left tap of its first pixel). Each input row is
+// streamed once per tile and reused by all the output rows of the block that it touches.
+template <typename V>
+static ISA_INLINE void direct_rows_body(const float* const* rows, const float* weights, const int kernel_width, const int kernel_height, float* values, const int width) {
+    static_assert(DIRECT_ROWS == 4, "The input rows are dispatched to blocks of 4 output rows.");
+    const int columns = V::LANES * V::VECTORS; // Output columns of the register tile.
+
+    for (int x0 = 0; x0 < width; x0 += columns) {
+        typename V::Vector accumulators[DIRECT_ROWS][V::VECTORS]; // Register tile.
+        for (int r = 0; r < DIRECT_ROWS; r++) {
+            for (int v = 0; v < V::VECTORS; v++) { V::broadcast(accumulators[r][v], 0.0f); }
+        }
+
+        // Input row i touches the output rows r such that 0 <= i - r < kernel_height (every one of them inside the block).
+        for (int i = 0; i < kernel_height + DIRECT_ROWS - 1; i++) {
+            const float* input = rows[i] + x0; // Input row of the tile.
+            const float* row_weights = weights + (size_t)i * kernel_width; // Kernel row of output row 0.
+
+            if (i >= DIRECT_ROWS - 1 && i < kernel_height) {
+                direct_accumulate<V, 0, 3>(accumulators, input, row_weights, kernel_width);
+            } else if (i == 0) {
+                direct_accumulate<V, 0, 0>(accumulators, input, row_weights, kernel_width);
+            } else if (i == 1) {
+                direct_accumulate<V, 0, 1>(accumulators, input, row_weights, kernel_width);
+            } else if (i == 2) {
+                direct_accumulate<V, 0, 2>(accumulators, input, row_weights, kernel_width);
+            } else if (i == kernel_height) {
+                direct_accumulate<V, 1, 3>(accumulators, input, row_weights, kernel_width);
+            } else if (i == kernel_height + 1) {
+                direct_accumulate<V, 2, 3>(accumulators, input, row_weights, kernel_width);
+            } else {
+                direct_accumulate<V, 3, 3>(accumulators, input, row_weights, kernel_width);
+            }
+        }
+
+        // Store the register tile (the columns past the row are dropped).
+        const int count = std::min(columns, width - x0); // Output columns in the row.
+        for (int r = 0; r < DIRECT_ROWS; r++) {
+            float tile[DIRECT_SLACK]; // Stored register tile row.
+            for (int v = 0; v < V::VECTORS; v++) { V::store(tile + v * V::LANES, accumulators[r][v]); }
+            std::copy(tile, tile + count, values + (size_t)r * width + x0);
+        }
+    }
+}
+
+static ISA_TARGET_SSE4_2 ISA_FLATTEN void direct_rows_sse4_2(const float* const* rows, const float* weights, const int kernel_width, const int kernel_height, float* values, const int width) {
+    direct_rows_body<Sse42Vectors>(rows, weights, kernel_width, kernel_height, values, width);
+}
+
+static ISA_TARGET_AVX2 ISA_FLATTEN void direct_rows_avx2(const float* const* rows, const float* weights, const int kernel_width, const int kernel_height, float* values, const int width) {
+    direct_rows_body<Avx2Vectors>(rows, weights, kernel_width, kernel_height, values, width);
+}
+
+static ISA_TARGET_AVX512 ISA_FLATTEN void direct_rows_avx512(const float* const* rows, const float* weights, const int kernel_width, const int kernel_height, float* values, const int width) {
+    direct_rows_body<Avx512Vectors>(rows, weights, kernel_width, kernel_height, values, width);
+}
+
+// Convolve a block of rows with the variant of the active instruction set.
+static void direct_rows(const float* const* rows, const float* weights, const int kernel_width, const int kernel_height, float* values, const int width) {
+    switch (Isa::get_instruction_set()) {
+        case InstructionSet::AVX512: direct_rows_avx512(rows, weights, kernel_width, kernel_height, values, width); break;
+        case InstructionSet::AVX2: direct_rows_avx2(rows, weights, kernel_width, kernel_height, values, width); break;
+        default: direct_rows_sse4_2(rows, weights, kernel_width, kernel_height, values, width);
+    }
+}
+
+static const int GEMM_MR = 4, GEMM_NR = 16; // Register tile of the filter bank matrix product (kernels by pixels).
+static const int GEMM_NC = 64; // Pixels lowered at once into the patch matrix (its columns).
+
+// Convolve a row of a channel plane with a bank of kernels as a matrix product (input points to the padded pixel of the top-left
+// tap of the first output pixel). Tiles of pixels are lowered into patch matrices (a row of converted samples per tap), multiplied
+// by the packed weights (panels of GEMM_MR kernels, tap-major) in register tiles of GEMM_MR kernels by GEMM_NR pixels.
+static void gemm_row(const uint8_t* input, const int padded_width, const int kernel_width, const int kernel_height, const std::vector<float>& packed_weights, const int kernel_count, float* values, const int width, float* patches) {
+    const int tap_block = 128; // Taps multiplied at once (patch matrix rows kept in cache).
+    const int taps = kernel_width * kernel_height; // Taps of the patch matrix.
+    const int panels = (kernel_count + GEMM_MR - 1) / GEMM_MR; // Kernel panels.
+
+    std::fill(values, values + (size_t)kernel_count * width, 0.0f);
+
+    for (int x0 = 0; x0 < width; x0 += GEMM_NC) {
+        const int count = std::min(GEMM_NC, width - x0); // Pixels in the tile.
+
+        // Lower the tile into the patch matrix (the columns past the image are zeroed to complete the last register tile).
+        for (int t = 0; t < taps; t++) {
+            const uint8_t* source = input + (size_t)(t / kernel_width) * padded_width + t % kernel_width + x0; // Shifted input row.
+            float* patch = patches + (size_t)t * GEMM_NC; // Patch matrix row.
+            for (int x = 0; x < count; x++) { patch[x] = source[x]; }
+            std::fill(patch + count, patch + GEMM_NC, 0.0f);
+        }
+
+        // Multiply the packed weights by the patch matrix, a block of taps at a time.
+        for (int t0 = 0; t0 < taps; t0 += tap_block) {
+            const int t1 = std::min(taps, t0 + tap_block); // End of the block of taps.
+
+            for (int panel = 0; panel < panels; panel++) {
+                const float* weights = packed_weights.data() + (size_t)panel * taps * GEMM_MR; // Packed weights of the panel.
+                const int rows = std::min(GEMM_MR, kernel_count - panel * GEMM_MR); // Kernels in the panel.
+
+                for (int n0 = 0; n0 < count; n0 += GEMM_NR) {
+                    const int columns = std::min(GEMM_NR, count - n0); // Pixels in the register tile.
+
+                    // Load the accumulators of the register tile.
+                    float accumulators[GEMM_MR][GEMM_NR] = {}; // Register tile.
+                    for (int r = 0; r < rows; r++) {
+                        const float* row_values = values + (size_t)(panel * GEMM_MR + r) * width + x0 + n0; // Output values of the kernel.
+                        for (int j = 0; j < columns; j++) { accumulators[r][j] = row_values[j]; }
+                    }
+
+                    // Accumulate the outer product of a weight column and a patch row per tap.
+                    for (int t = t0; t < t1; t++) {
+                        const float* patch = patches + (size_t)t * GEMM_NC + n0; // Patch row of the register tile.
+                        const float* w = weights + (size_t)t * GEMM_MR; // Weights of the tap.
+                        for (int r = 0; r < GEMM_MR; r++) {
+                            const float weight = w[r]; // Tap weight of the kernel.
+                            #pragma omp simd
+                            for (int j = 0; j < GEMM_NR; j++) { accumulators[r][j] += weight * patch[j]; }
+                        }
+                    }
+
+                    // Store the accumulators of the register tile.
+                    for (int r = 0; r < rows; r++) {
+                        float* row_values = values + (size_t)(panel * GEMM_MR + r) * width + x0 + n0; // Output values of the kernel.
+                        for (int j = 0; j < columns; j++) { row_values[j] = accumulators[r][j]; }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Convolve a row of a channel plane with a separable kernel (input points to the padded pixel of the top-left tap of the first output pixel):
+// the padded rows are first combined by the column vector, then the combined row by the row vector.
+static void separable_row(const uint8_t* input, const int padded_width, const std::vector<float>& column_vector, const std::vector<float>& row_vector, float* column_values, float* values, const int width) {
+    const int padded_row = width + (int)row_vector.size() - 1; // Padded pixels of the row read by the horizontal pass.
+
+    // Vertical pass.
+    std::fill(column_values, column_values + padded_row, 0.0f);
+    for (size_t ky = 0; ky < column_vector.size(); ky++) {
+        const uint8_t* source = input + ky * padded_width; // Padded row of the tap.
+        const float weight = column_vector[ky]; // Tap weight.
+        #pragma omp simd
+        for (int x = 0; x < padded_row; x++) { column_values[x] += weight * source[x]; }
+    }
+
+    // Horizontal pass.
+    std::fill(values, values + width, 0.0f);
+    for (size_t kx = 0; kx < row_vector.size(); kx++) {
+        const float* source = column_values + kx; // Shifted combined row.
+        const float weight = row_vector[kx]; // Tap weight.
+        #pragma omp simd
+        for (int x = 0; x < width; x++) { values[x] += weight * source[x]; }
+    }
+}
+
+// Apply a pipeline stage to a row (input points to the pixel of the first output pixel, surrounded by the halo of the stage).
+static void stage_row(const Sequential::PipelineStage& stage, const uint8_t* input, const int input_width, float* values, const int width) {
+    const int radius = stage.radius; // Window radius.
+
+    if (stage.operation == Sequential::PipelineStage::CONVOLUTION) {
+        taps_row(input, input_width, stage.kernel->get_properties()->tap_groups, values, width);
+    } else if (stage.operation == Sequential::PipelineStage::MEDIAN) {
+        std::vector<uint8_t> window((2 * radius + 1) * (2 * radius + 1)); // Window samples.
+        for (int x = 0; x < width; x++) {
+            size_t i = 0; // Window sample index.
+            for (int dy = -radius; dy <= radius; dy++) {
+                for (int dx = -radius; dx <= radius; dx++) { window[i++] = input[(ptrdiff_t)dy * input_width + x + dx]; }
+            }
+            std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+            values[x] = window[window.size() / 2];
+        }
+    } else {
+        const bool is_erosion = (stage.operation == Sequential::PipelineStage::EROSION); // Whether to take the minimum.
+        std::fill(values, values + width, is_erosion ? 255.0f : 0.0f);
+        for (int dy = -radius; dy <= radius; dy++) {
+            for (int dx = -radius; dx <= radius; dx++) {
+                const uint8_t* source = input + (ptrdiff_t)dy * input_width + dx; // Shifted input row.
+                if (is_erosion) {
+                    #pragma omp simd
+                    for (int x = 0; x < width; x++) { values[x] = std::min(values[x], (float)source[x]); }
+                } else {
+                    #pragma omp simd
+                    for (int x = 0; x < width; x++) { values[x] = std::max(values[x], (float)source[x]); }
+                }
+            }
+        }
+    }
+}
+
+// Store a row of output values with the given pixel stride (saturated to the sample range unless the kernel output fits it).
+template <typename T>
+static ISA_INLINE void store_row_body(const float* values, T* output, const int stride, const int width, const bool is_output_in_range) {
+    if (is_output_in_range) {
+        for (int x = 0; x < width; x++) { output[(size_t)x * stride] = (T)values[x]; }
+    } else {
+        for (int x = 0; x < width; x++) { output[(size_t)x * stride] = SampleTraits<T>::saturate(values[x]); }
+    }
+}
+
+#if ISA_DISPATCH
+// Contiguous 8 bits rows are clamped, truncated and packed by blocks of pixels (in range outputs are unaffected by the clamp),
+// other rows by the vectorised body.
+template <typename T>
+static ISA_TARGET_SSE4_2 void store_row_sse4_2(const float* values, T* output, const int stride, const int width, const bool is_output_in_range) {
+    int x = 0;
+    if (sizeof(T) == 1 && stride == 1) {
+        const __m128 low = _mm_set1_ps(0.0f), high = _mm_set1_ps(255.0f); // Sample range.
+        for (; x + 16 <= width; x += 16) {
+            __m128i quarters[4]; // Truncated values of each quarter of the block.
+            for (int q = 0; q < 4; q++) {
+                quarters[q] = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(values + x + 4 * q), low), high));
+            }
+            const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(quarters[0], quarters[1]), _mm_packs_epi32(quarters[2], quarters[3]));
+            _mm_storeu_si128((__m128i*)(output + x), packed);
+        }
+    }
+    store_row_body(values + x, output + (size_t)x * stride, stride, width - x, is_output_in_range);
+}
+
+template <typename T>
+static ISA_TARGET_AVX2 void store_row_avx2(const float* values, T* output, const int stride, const int width, const bool is_output_in_range) {
+    int x = 0;
+    if (sizeof(T) == 1 && stride == 1) {
+        const __m256 low = _mm256_set1_ps(0.0f), high = _mm256_set1_ps(255.0f); // Sample range.
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7); // Pixel order of the in-lane packs.
+        for (; x + 32 <= width; x += 32) {
+            __m256i quarters[4]; // Truncated values of each quarter of the block.
+            for (int q = 0; q < 4; q++) {
+                quarters[q] = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(values + x + 8 * q), low), high));
+            }
+            const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(quarters[0], quarters[1]), _mm256_packs_epi32(quarters[2], quarters[3]));
+            _mm256_storeu_si256((__m256i*)(output + x), _mm256_permutevar8x32_epi32(packed, order));
+        }
+    }
+    store_row_body(values + x, output + (size_t)x * stride, stride, width - x, is_output_in_range);
+}
+
+template <typename T>
+static ISA_TARGET_AVX512 void store_row_avx512(const float* values, T* output, const int stride, const int width, const bool is_output_in_range) {
+    int x = 0;
+    if (sizeof(T) == 1 && stride == 1) {
+        const __m512 low = _mm512_set1_ps(0.0f), high = _mm512_set1_ps(255.0f); // Sample range.
+        for (; x + 16 <= width; x += 16) {
+            const __m512i truncated = _mm512_cvttps_epi32(_mm512_min_ps(_mm512_max_ps(_mm512_loadu_ps(values + x), low), high));
+            _mm_storeu_si128((__m128i*)(output + x), _mm512_cvtepi32_epi8(truncated));
+        }
+    }
+    store_row_body(values + x, output + (size_t)x * stride, stride, width - x, is_output_in_range);
+}
+#endif
+
+// Store a row with the variant of the active instruction set.
+template <typename T>
+static void store_row(const float* values, T* output, const int stride, const int width, const bool is_output_in_range) {
+    switch (Isa::get_instruction_set()) {
+#if ISA_DISPATCH
+        case InstructionSet::AVX512: store_row_avx512(values, output, stride, width, is_output_in_range); break;
+        case InstructionSet::AVX2: store_row_avx2(values, output, stride, width, is_output_in_range); break;
+        case InstructionSet::SSE4_2: store_row_sse4_2(values, output, stride, width, is_output_in_range); break;
+#endif
+        default: store_row_body(values, output, stride, width, is_output_in_range);
+    }
+}
+
+// Convolve the rows [begin, end) of a channel plane with a dense kernel by blocks of DIRECT_ROWS rows (input points to the padded
+// sample of the top-left tap of the first pixel, followed by input_rows readable rows). The input rows are converted once into a
+// ring of float rows, shared by the consecutive blocks that read them.
+static void direct_band(const uint8_t* input, const int padded_width, const int input_rows, const Kernel& kernel, const int begin, const int end, uint8_t* output, const int output_stride, const int width) {
+    const int kernel_width = kernel.get_width(); // Kernel width.
+    const int kernel_height = kernel.get_height(); // Kernel height.
+    const bool is_output_in_range = kernel.get_properties()->is_output_in_range; // Whether the clamp can be skipped.
+
+    // Ring of converted input rows (the rows past the input, only read by the rows past the band, are zeros).
+    const int ring_size = kernel_height + DIRECT_ROWS - 1; // Input rows of a block.
+    const int row_length = padded_width + DIRECT_SLACK; // Converted row length.
+    std::vector<float> ring((size_t)(ring_size + 1) * row_length, 0.0f); // Converted rows, followed by the zero row.
+    const float* zero_row = ring.data() + (size_t)ring_size * row_length; // Zero row.
+    std::vector<const float*> rows(ring_size); // Input rows of the block.
+    std::vector<float> values((size_t)DIRECT_ROWS * width); // Output values of the block.
+
+    int next_row = begin; // First input row not converted yet.
+    for (int y = begin; y < end; y += DIRECT_ROWS) {
+        // Convert the input rows of the block read for the first time.
+        for (int i = 0; i < ring_size; i++) {
+            const int row = y + i; // Input row.
+            if (row >= input_rows) { rows[i] = zero_row; continue; }
+
+            float* converted = ring.data() + (size_t)(row % ring_size) * row_length; // Ring slot of the row.
+            if (row >= next_row) {
+                const uint8_t* source = input + (size_t)row * padded_width; // Padded input row.
+                #pragma omp simd
+                for (int x = 0; x < padded_width; x++) { converted[x] = source[x]; }
+                next_row = row + 1;
+            }
+            rows[i] = converted;
+        }
+
+        // Convolve the block and store its rows inside the band.
+        direct_rows(rows.data(), kernel.get_data(), kernel_width, kernel_height, values.data(), width);
+        for (int r = 0; r < DIRECT_ROWS && y + r < end; r++) {
+            store_row(values.data() + (size_t)r * width, output + (size_t)(y + r) * width * output_stride, output_stride, width, is_output_in_range);
+        }
+    }
+}
+#endif
+
+// Whether a kernel is convolved by the direct engine (mid-size dense kernels with a vector instruction set).
+static bool is_direct_kernel(const Kernel& kernel, const KernelProperties& properties) {
+#if ISA_DISPATCH
+    return Isa::get_instruction_set() != InstructionSet::BASELINE && properties.density >= DENSE_MIN_DENSITY && std::min(kernel.get_width(), kernel.get_height()) >= DIRECT_MIN_SIZE;
+#else
+    (void)kernel;
+    (void)properties;
+    return false;
+#endif
+}
+
+
+// Gaussian approximations.
+
+static const int RECURSIVE_LANES = 16; // Lines filtered at once by the gaussian approximations (interleaved, one per vector lane).
+static const int GAUSSIAN_STRIP_LANES = 16; // Blocks of lanes of the column strips of the gaussian approximations (contiguous 1 KB runs).
+static const int RECURSIVE_PAIRS = 2; // Pairs of complex conjugate poles of the recursive gaussian filters.
+
+// Coefficients of the 4th order recursive gaussian of Deriche, as the sum of a causal and an anticausal filter, each one the real part
+// of a sum of complex first order recursions (stable in single precision whatever the sigma):
+// causal[n] = Re(sum(c[k][n])) with c[k][n] = causal_weight[k] * x[n] + pole[k] * c[k][n - 1], and
+// anticausal[n] = Re(sum(a[k][n])) with a[k][n] = anticausal_weight[k] * x[n + 1] + pole[k] * a[k][n + 1].
+struct RecursiveCoefficients {
+    std::complex<float> pole[RECURSIVE_PAIRS], causal_weight[RECURSIVE_PAIRS], anticausal_weight[RECURSIVE_PAIRS];
+
+    // Steady states of the recursions for a unit constant input (the boundary state of the recursions).
+    std::complex<float> causal_state[RECURSIVE_PAIRS], anticausal_state[RECURSIVE_PAIRS];
+};
+
+static RecursiveCoefficients recursive_coefficients(const float sigma) {
+    // Gaussian fitted by Deriche with two pairs of damped complex exponentials: 2 * Re(sum(alpha[k] * exp(-lambda[k] * t / sigma))) for t >= 0.
+    static const std::complex<double> alpha[RECURSIVE_PAIRS] = {{0.84, 1.8675}, {-0.34015, -0.1299}};
+    static const std::complex<double> lambda[RECURSIVE_PAIRS] = {{1.783, 0.6318}, {1.723, 1.997}};
+
+    // Gain of the whole filter (causal plus anticausal, without counting the center twice): 2 * Re(sum(alpha * (1 + pole) / (1 - pole))).
+    std::complex<double> poles[RECURSIVE_PAIRS]; // Filter poles.
+    double gain = 0; // Filter gain.
+    for (int k = 0; k < RECURSIVE_PAIRS; k++) {
+        poles[k] = std::exp(-lambda[k] / (double)sigma);
+        gain += 2.0 * (alpha[k] * (1.0 + poles[k]) / (1.0 - poles[k])).real();
+    }
+
+    // Normalise the gain to one (the factor 2 of the conjugate poles is folded into the weights).
+    RecursiveCoefficients coefficients;
+    for (int k = 0; k < RECURSIVE_PAIRS; k++) {
+        const std::complex<double> weight = 2.0 * alpha[k] / gain; // Causal weight.
+        coefficients.pole[k] = std::complex<float>(poles[k]);
+        coefficients.causal_weight[k] = std::complex<float>(weight);
+        coefficients.anticausal_weight[k] = std::complex<float>(weight * poles[k]);
+        coefficients.causal_state[k] = std::complex<float>(weight / (1.0 - poles[k]));
+        coefficients.anticausal_state[k] = std::complex<float>(weight * poles[k] / (1.0 - poles[k]));
+    }
+
+    return coefficients;
+}
+
+// Distance beyond which the samples have no visible weight on the recursive filter (the margin of the mirrored borders).
+static int recursive_margin(const float sigma) {
+    return (int)std::ceil(4.0f * sigma) + 2;
+}
+
+// Filter a block of RECURSIVE_LANES interleaved lines of length samples in place, the samples of a line being pitch floats apart
+// (causal is a scratch buffer of length interleaved samples). The recursions start from the steady state of the first and last
+// samples, so constant lines are unchanged.
+static ISA_INLINE void recursive_lines_body(float* block, float* causal, const int length, const int pitch, const RecursiveCoefficients& coefficients) {
+    const float p0r = coefficients.pole[0].real(), p0i = coefficients.pole[0].imag(); // First pole.
+    const float p1r = coefficients.pole[1].real(), p1i = coefficients.pole[1].imag(); // Second pole.
+    float s0r[RECURSIVE_LANES], s0i[RECURSIVE_LANES], s1r[RECURSIVE_LANES], s1i[RECURSIVE_LANES]; // Recursion states of each line.
+
+    // Causal pass.
+    {
+        const float w0r = coefficients.causal_weight[0].real(), w0i = coefficients.causal_weight[0].imag(); // First weight.
+        const float w1r = coefficients.causal_weight[1].real(), w1i = coefficients.causal_weight[1].imag(); // Second weight.
+        for (int r = 0; r < RECURSIVE_LANES; r++) {
+            s0r[r] = coefficients.causal_state[0].real() * block[r];
+            s0i[r] = coefficients.causal_state[0].imag() * block[r];
+            s1r[r] = coefficients.causal_state[1].real() * block[r];
+            s1i[r] = coefficients.causal_state[1].imag() * block[r];
+        }
+        for (int n = 0; n < length; n++) {
+            const float* samples = block + (size_t)n * pitch; // Samples of the lines.
+            float* outputs = causal + (size_t)n * RECURSIVE_LANES; // Causal outputs of the lines.
+            #pragma omp simd
+            for (int r = 0; r < RECURSIVE_LANES; r++) {
+                const float x = samples[r]; // Input sample.
+                const float t0r = w0r * x + p0r * s0r[r] - p0i * s0i[r], t0i = w0i * x + p0r * s0i[r] + p0i * s0r[r]; // First recursion.
+                const float t1r = w1r * x + p1r * s1r[r] - p1i * s1i[r], t1i = w1i * x + p1r * s1i[r] + p1i * s1r[r]; // Second recursion.
+                s0r[r] = t0r; s0i[r] = t0i; s1r[r] = t1r; s1i[r] = t1i;
+                outputs[r] = t0r + t1r;
+            }
+        }
+    }
+
+    // Anticausal pass, added to the causal one.
+    {
+        const float w0r = coefficients.anticausal_weight[0].real(), w0i = coefficients.anticausal_weight[0].imag(); // First weight.
+        const float w1r = coefficients.anticausal_weight[1].real(), w1i = coefficients.anticausal_weight[1].imag(); // Second weight.
+        float next[RECURSIVE_LANES]; // Next sample of each line.
+        for (int r = 0; r < RECURSIVE_LANES; r++) {
+            next[r] = block[(size_t)(length - 1) * pitch + r];
+            s0r[r] = coefficients.anticausal_state[0].real() * next[r];
+            s0i[r] = coefficients.anticausal_state[0].imag() * next[r];
+            s1r[r] = coefficients.anticausal_state[1].real() * next[r];
+            s1i[r] = coefficients.anticausal_state[1].imag() * next[r];
+        }
+        for (int n = length - 1; n >= 0; n--) {
+            float* samples = block + (size_t)n * pitch; // Samples of the lines.
+            const float* outputs = causal + (size_t)n * RECURSIVE_LANES; // Causal outputs of the lines.
+            #pragma omp simd
+            for (int r = 0; r < RECURSIVE_LANES; r++) {
+                const float x = next[r]; // Input sample.
+                const float t0r = w0r * x + p0r * s0r[r] - p0i * s0i[r], t0i = w0i * x + p0r * s0i[r] + p0i * s0r[r]; // First recursion.
+                const float t1r = w1r * x + p1r * s1r[r] - p1i * s1i[r], t1i = w1i * x + p1r * s1i[r] + p1i * s1r[r]; // Second recursion.
+                s0r[r] = t0r; s0i[r] = t0i; s1r[r] = t1r; s1i[r] = t1i;
+                next[r] = samples[r];
+                samples[r] = outputs[r] + t0r + t1r;
+            }
+        }
+    }
+}
+
+#if ISA_DISPATCH
+static ISA_TARGET_SSE4_2 void recursive_lines_sse4_2(float* block, float* causal, const int length, const int pitch, const RecursiveCoefficients& coefficients) {
+    recursive_lines_body(block, causal, length, pitch, coefficients);
+}
+
+static ISA_TARGET_AVX2 void recursive_lines_avx2(float* block, float* causal, const int length, const int pitch, const RecursiveCoefficients& coefficients) {
+    recursive_lines_body(block, causal, length, pitch, coefficients);
+}
+
+static ISA_TARGET_AVX512 void recursive_lines_avx512(float* block, float* causal, const int length, const int pitch, const RecursiveCoefficients& coefficients) {
+    recursive_lines_body(block, causal, length, pitch, coefficients);
+}
+#endif
+
+// Filter a block of lines with the variant of the active instruction set.
+static void recursive_lines(float* block, float* causal, const int length, const int pitch, const RecursiveCoefficients& coefficients) {
+    switch (Isa::get_instruction_set()) {
+#if ISA_DISPATCH
+        case InstructionSet::AVX512: recursive_lines_avx512(block, causal, length, pitch, coefficients); break;
+        case InstructionSet::AVX2: recursive_lines_avx2(block, causal, length, pitch, coefficients); break;
+        case InstructionSet::SSE4_2: recursive_lines_sse4_2(block, causal, length, pitch, coefficients); break;
+#endif
+        default: recursive_lines_body(block, causal, length, pitch, coefficients);
+    }
+}
+
+// Radii of the BOX_PASSES successive box blurs approximating a gaussian: the widths are the two odd integers around the ideal width
+// (the narrower ones first), mixed so that the variance of the boxes ((width^2 - 1) / 12 each) is the closest to the one of the gaussian.
+static std::vector<int> box_radii(const float sigma) {
+    const double variance = 12.0 * sigma * sigma; // Variance of the gaussian, in units of 1 / 12.
+    int lower = (int)std::floor(std::sqrt(variance / BOX_PASSES + 1.0)); // Narrower box width.
+    if (lower % 2 == 0) { lower--; }
+    const long narrow = std::lround((variance - BOX_PASSES * (lower * lower + 4.0 * lower + 3.0)) / (-4.0 * lower - 4.0)); // Narrower boxes.
+
+    std::vector<int> radii(BOX_PASSES); // Box radii.
+    for (int i = 0; i < BOX_PASSES; i++) { radii[i] = (i < narrow) ? lower / 2 : lower / 2 + 1; }
+
+    return radii;
+}
+
+// Filter a block of RECURSIVE_LANES interleaved lines of length samples (pitch floats apart) in place by successive box blurs, fused
+// in one sweep along the lines: each box keeps a running sum over a ring of its last inputs (the outputs of the previous box), so
+// the intermediate lines never leave the L1 cache. Each box shrinks the valid samples by its radius at both ends, so only the samples
+// beyond the sum of the radii from the ends are filtered.
+static ISA_INLINE void box_lines_body(float* block, const int length, const int pitch, const std::vector<int>& radii) {
+    const int passes = (int)radii.size(); // Number of boxes.
+
+    // Rings of the boxes (a box of width w keeps its last w inputs, the oldest one leaving the sum when a new one enters).
+    int ring_size = 0; // Samples of the rings.
+    int margin = 0; // Sum of the radii (delay of the outputs behind the inputs).
+    for (const int radius : radii) { ring_size += 2 * radius + 1; margin += radius; }
+    std::vector<float> rings((size_t)ring_size * RECURSIVE_LANES); // Rings of the boxes.
+    std::vector<float> sums((size_t)passes * RECURSIVE_LANES, 0.0f); // Running sums of the boxes.
+    std::vector<int> slots(passes, 0); // Slot of the next input of each ring (holding its oldest input).
+
+    for (int i = 0; i < length; i++) {
+        float values[RECURSIVE_LANES]; // Samples entering the current box.
+        std::copy(block + (size_t)i * pitch, block + (size_t)i * pitch + RECURSIVE_LANES, values);
+
+        // Push the sample through the boxes, as long as they have filled their window.
+        int index = i; // Index of the sample among the inputs of the current box.
+        float* ring = rings.data(); // Ring of the current box.
+        int pass = 0; // Current box.
+        for (; pass < passes; pass++) {
+            const int width = 2 * radii[pass] + 1; // Box width.
+            const float scale = 1.0f / width; // Box weight.
+            float* slot = ring + (size_t)slots[pass] * RECURSIVE_LANES; // Slot of the sample (holding the leaving one).
+            float* sum = sums.data() + (size_t)pass * RECURSIVE_LANES; // Running sums of the box.
+            slots[pass] = (slots[pass] + 1 == width) ? 0 : slots[pass] + 1;
+
+            if (index >= width) {
+                #pragma omp simd
+                for (int r = 0; r < RECURSIVE_LANES; r++) { sum[r] += values[r] - slot[r]; slot[r] = values[r]; values[r] = sum[r] * scale; }
+            } else {
+                #pragma omp simd
+                for (int r = 0; r < RECURSIVE_LANES; r++) { sum[r] += values[r]; slot[r] = values[r]; values[r] = sum[r] * scale; }
+                if (index < width - 1) { break; }
+            }
+
+            ring += (size_t)width * RECURSIVE_LANES;
+            index -= width - 1;
+        }
+
+        // Store the output of the last box (behind the samples still to be read).
+        if (pass == passes) { std::copy(values, values + RECURSIVE_LANES, block + (size_t)(i - margin) * pitch); }
+    }
+}
+
+#if ISA_DISPATCH
+static ISA_TARGET_SSE4_2 void box_lines_sse4_2(float* block, const int length, const int pitch, const std::vector<int>& radii) {
+    box_lines_body(block, length, pitch, radii);
+}
+
+static ISA_TARGET_AVX2 void box_lines_avx2(float* block, const int length, const int pitch, const std::vector<int>& radii) {
+    box_lines_body(block, length, pitch, radii);
+}
+
+static ISA_TARGET_AVX512 void box_lines_avx512(float* block, const int length, const int pitch, const std::vector<int>& radii) {
+    box_lines_body(block, length, pitch, radii);
+}
+#endif
+
+// Filter a block of lines by successive box blurs with the variant of the active instruction set.
+static void box_lines(float* block, const int length, const int pitch, const std::vector<int>& radii) {
+    switch (Isa::get_instruction_set()) {
+#if ISA_DISPATCH
+        case InstructionSet::AVX512: box_lines_avx512(block, length, pitch, radii); break;
+        case InstructionSet::AVX2: box_lines_avx2(block, length, pitch, radii); break;
+        case InstructionSet::SSE4_2: box_lines_sse4_2(block, length, pitch, radii); break;
+#endif
+        default: box_lines_body(block, length, pitch, radii);
+    }
+}
+
+// Gaussian approximation of a blur: the coefficients of the recursive filter, or the radii of the box blurs.
+struct GaussianFilter {
+    Sequential::GaussianMethod method; // Approximation method.
+    RecursiveCoefficients coefficients; // Coefficients of the recursive filter.
+    std::vector<int> radii; // Radii of the box blurs.
+    int radius; // Distance beyond which the samples have no (visible) weight.
+    int margin; // Margin of padded samples filtered before and after the lines.
+
+    GaussianFilter(const float sigma, const Sequential::GaussianMethod method, const PaddingType padding_type) : method(method) {
+        if (method == Sequential::BOX_GAUSSIAN) {
+            radii = box_radii(sigma);
+            radius = 0;
+            for (const int box_radius : radii) { radius += box_radius; }
+            margin = radius;
+        } else {
+            // The recursions start from the steady state of the first and last samples, which is exact for replicated borders,
+            // and for zero borders from a single zero sample: only mirrored borders need the samples of the margin.
+            coefficients = recursive_coefficients(sigma);
+            radius = recursive_margin(sigma);
+            margin = (padding_type == PaddingType::MIRROR) ? radius : (padding_type == PaddingType::ZERO) ? 1 : 0;
+        }
+    }
+
+    // Filter a block of RECURSIVE_LANES interleaved lines of length samples (pitch floats apart) in place (scratch is a buffer of
+    // length interleaved samples, for the causal pass of the recursive filter).
+    void filter_lines(float* block, float* scratch, const int length, const int pitch) const {
+        if (method == Sequential::BOX_GAUSSIAN) {
+            box_lines(block, length, pitch, radii);
+        } else {
+            recursive_lines(block, scratch, length, pitch, coefficients);
+        }
+    }
+};
+
+
+// Pipeline stages.
+
+Sequential::PipelineStage Sequential::PipelineStage::convolution(const Kernel& kernel) {
+    PipelineStage stage; // Convolution stage.
+    stage.operation = CONVOLUTION;
+    stage.kernel = std::make_shared<const Kernel>(kernel);
+    stage.radius = std::max(kernel.get_width(), kernel.get_height()) / 2;
+    return stage;
+}
+
+Sequential::PipelineStage Sequential::PipelineStage::window(const Operation operation, const int radius) {
+    // Check if the stage is a window operation.
+    if (operation == CONVOLUTION || radius < 0) {
+        std::cerr << "Error: Invalid window stage." << std::endl;
+        throw std::invalid_argument("Invalid window stage.");
+    }
+
+    PipelineStage stage; // Window stage.
+    stage.operation = operation;
+    stage.radius = radius;
+    return stage;
+}
+
+
+// Band size.
+
+int Sequential::Convolution::band_size = BAND_SIZE;
 
 
 // Methods.
 
-Image Sequential::Convolution::convolve(const Image& image, const Kernel& kernel, PaddingType padding_type, std::string results_path) {
+Image Sequential::Convolution::convolve(const Image& image, const Kernel& kernel, PaddingType padding_type, std::string results_path, const uint32_t channel_mask) {
+    // Apply the kernel to the selected channels only.
+    std::vector<const Kernel*> kernels(image.get_channels(), NULL); // Kernel of each channel.
+    for (int channel = 0; channel < image.get_channels(); channel++) {
+        if (is_channel_selected(channel_mask, channel)) { kernels[channel] = &kernel; }
+    }
+
+    return convolve_channels(image, kernels, padding_type, results_path);
+}
+
+Image Sequential::Convolution::convolve_channels(const Image& image, const std::vector<const Kernel*>& kernels, PaddingType padding_type, std::string results_path) {
     // Get the input image dimensions.
     const int width = image.get_width(); // Image width.
     const int height = image.get_height(); // Image height.
     const int channels = image.get_channels(); // Image channels.
 
-    // Get the kernel dimensions.
-    const int kernel_width = kernel.get_width(); // Kernel width.
-    const int kernel_height = kernel.get_height(); // Kernel height.
+    // Check if there is a kernel entry for every channel.
+    if ((int)kernels.size() != channels) {
+        std::cerr << "Error: Expected " << channels << " channel kernels, got " << kernels.size() << "." << std::endl;
+        throw std::invalid_argument("Invalid number of channel kernels.");
+    }
+
+    // Get the largest kernel dimensions and the channels to be convolved.
+    int kernel_width = 1, kernel_height = 1; // Kernel dimensions.
+    uint32_t channel_mask = 0; // Convolved channels.
+    for (int channel = 0; channel < channels; channel++) {
+        if (kernels[channel] != NULL) {
+            kernel_width = std::max(kernel_width, kernels[channel]->get_width());
+            kernel_height = std::max(kernel_height, kernels[channel]->get_height());
+            if (channel < 32) { channel_mask |= (1u << channel); }
+        }
+    }
 
 
-    // Apply padding to the input image.
+    // Apply padding to the convolved channels of the input image.
     const int padding_width = std::floor((float)kernel_width / 2); // Padding width.
     const int padding_height = std::floor((float)kernel_height / 2); // Padding height.
-    Image padded_image = image.padding(padding_width, padding_height, padding_type); // Padded image.
+    const Image padded_image = image.padding(padding_width, padding_height, padding_type, channel_mask); // Padded image.
 
 
-    // Initialize the output image data.
-    Image output_image = Image(width, height, channels, image.get_is_SoA()); // Output image.
+    // Initialize the output image data (first touched by the threads writing its bands).
+    Image output_image = Image::uninitialized(width, height, channels, image.get_is_SoA()); // Output image.
 
 
     // Print the execution information.
@@ -43,7 +820,7 @@ Image Sequential::Convolution::convolve(const Image& image, const Kernel& kernel
         if (VERBOSITY >= 2) std::cout << "\tIteration: " << i;
 
         // Convolve the image.
-        output_image = convolution(image, kernel, padded_image);
+        convolution(image, kernels, padded_image, output_image);
 
         // End iteration execution time.
         auto end_time = std::chrono::high_resolution_clock::now();
@@ -71,55 +848,1237 @@ Image Sequential::Convolution::convolve(const Image& image, const Kernel& kernel
     return output_image;
 }
 
-Image Sequential::Convolution::convolution(const Image& image, const Kernel& kernel, const Image& padded_image) {
+template <typename T>
+BasicImage<T> Sequential::Convolution::convolve_samples(const BasicImage<T>& image, const Kernel& kernel, PaddingType padding_type, std::string results_path, const uint32_t channel_mask) {
     // Get the input image dimensions.
     const int width = image.get_width(); // Image width.
     const int height = image.get_height(); // Image height.
     const int channels = image.get_channels(); // Image channels.
 
-    // Get the kernel dimensions.
-    const int kernel_width = kernel.get_width(); // Kernel width.
-    const int kernel_height = kernel.get_height(); // Kernel height.
+    // Apply padding to the convolved channels of the input image, and read its channel planes.
+    const int padding_width = kernel.get_width() / 2; // Padding width.
+    const int padding_height = kernel.get_height() / 2; // Padding height.
+    const BasicImage<T> padded_planes = image.padding(padding_width, padding_height, padding_type, channel_mask).converted(true); // Padded image in SoA layout.
+    const int padded_width = padded_planes.get_width(); // Padded image width.
+    const size_t padded_pixels = (size_t)padded_width * padded_planes.get_height(); // Number of padded pixels.
 
-    // Get the padded image dimensions.
-    const int padded_width = padded_image.get_width(); // Padded image width.
-    const int padded_height = padded_image.get_height(); // Padded image height.
+    // Initialize the output image data (first touched by the threads writing its bands).
+    BasicImage<T> output_image = BasicImage<T>::uninitialized(width, height, channels, image.get_is_SoA()); // Output image.
+    T* output_data = output_image.get_data(); // Output image data.
+    const size_t pixels = (size_t)width * height; // Number of pixels.
+    const int output_stride = image.get_is_SoA() ? 1 : channels; // Distance between the pixels of a channel.
+    const std::shared_ptr<const KernelProperties> properties = kernel.get_properties(); // Kernel properties.
+    const std::vector<KernelTapGroup>& tap_groups = properties->tap_groups; // Non-zero taps of the kernel.
 
 
-    // Get padding dimensions.
-    const int padding_width = (padded_width - width) / 2; // Padding width.
-    const int padding_height = (padded_height - height) / 2; // Padding height.
+    // Print the execution information.
+    if (VERBOSITY >= 1) std::cout << "Starting sequential convolution of " << sizeof(T) * 8 << " bits samples..." << std::endl;
 
+    // Execution time.
+    float execution_time = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        // Start iteration execution time.
+        auto start_time = std::chrono::high_resolution_clock::now();
+        if (VERBOSITY >= 2) std::cout << "\tIteration: " << i;
 
-    // Initialize the output image.
-    Image output_image = Image(width, height, channels, image.get_is_SoA()); // Output image.
+        // Iterate over the image in bands of rows, processed by the CPU threads.
+        const int band_rows = std::max(1, band_size / std::max(1, width * channels * (int)sizeof(T))); // Rows per band.
+        ThreadPool::get_instance().parallel_for(height, band_rows, [&](const int begin, const int end) {
+            std::vector<float> values(width); // Output values of a row.
 
+            for (int channel = 0; channel < channels; channel++) {
+                // Skip the channels copied through below.
+                if (!is_channel_selected(channel_mask, channel)) { continue; }
 
-    // Iterate over the image.
-    for (int channel = 0; channel < channels; channel++) {
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                // Output value for the current pixel.
-                float output_value = 0;
-
-                // Iterate over the kernel.
-                for (int ky = 0; ky < kernel_height; ky++) {
-                    for (int kx = 0; kx < kernel_width; kx++) {
-                        // Get the pixel index to be convolved.
-                        const int col = x + kx - std::floor((float)kernel_width / 2) + padding_width; // Column index.
-                        const int row = y + ky - std::floor((float)kernel_width / 2) + padding_height; // Row index.
-
-                        // Convolve the pixel.
-                        output_value += padded_image(col, row, channel) * kernel(kx, ky);
-                    }
-                }
+                const T* input = padded_planes.get_data() + channel * padded_pixels; // Padded channel plane.
+                T* output = output_data + (image.get_is_SoA() ? channel * pixels : channel); // Output channel.
 
-                // Set the output value (clamped between 0 and 255).
-                output_image(x, y, channel) = (uint8_t)clamp(0.0f, output_value, 255.0f);
+                for (int y = begin; y < end; y++) {
+                    taps_row(input + (size_t)(y + padding_height) * padded_width + padding_width, padded_width, tap_groups, values.data(), width);
+                    store_row(values.data(), output + (size_t)y * width * output_stride, output_stride, width, false);
+                }
             }
-        }
+        });
+
+        // End iteration execution time.
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        // Measure the iteration execution time.
+        float iteration_execution_time = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+        execution_time += iteration_execution_time;
+
+        // Print the iteration execution time.
+        if (VERBOSITY >= 2) std::cout << " - Execution: " << iteration_execution_time << " ms" << std::endl;
+    }
+
+    // Print the execution time.
+    if (VERBOSITY >= 1) std::cout << "Execution time: " << execution_time / ITERATIONS << " ms (average of " << ITERATIONS << " runs)" << std::endl;
+
+
+    // Copy the channels without kernel through.
+    for (int channel = 0; channel < channels; channel++) {
+        if (!is_channel_selected(channel_mask, channel)) { output_image.copy_channel(image, channel, channel); }
+    }
+
+
+    // Save the results.
+    if (!results_path.empty()) {
+        std::string execution_type = "sequential_" + std::to_string(sizeof(T) * 8) + "bits";
+        save_results(results_path, execution_type, width, height, channels, image.get_is_SoA(), kernel.get_width(), kernel.get_height(), execution_time / ITERATIONS, ITERATIONS);
     }
 
+
     // Return the convolved image.
     return output_image;
 }
+
+// 8 bits images are convolved by the dispatching engines.
+template <>
+Image Sequential::Convolution::convolve_samples(const Image& image, const Kernel& kernel, PaddingType padding_type, std::string results_path, const uint32_t channel_mask) {
+    return convolve(image, kernel, padding_type, results_path, channel_mask);
+}
+
+template BasicImage<uint16_t> Sequential::Convolution::convolve_samples(const BasicImage<uint16_t>&, const Kernel&, PaddingType, std::string, const uint32_t);
+template BasicImage<int16_t> Sequential::Convolution::convolve_samples(const BasicImage<int16_t>&, const Kernel&, PaddingType, std::string, const uint32_t);
+template BasicImage<float> Sequential::Convolution::convolve_samples(const BasicImage<float>&, const Kernel&, PaddingType, std::string, const uint32_t);
+
+Image Sequential::Convolution::convolve_luma(const Image& image, const Kernel& kernel, PaddingType padding_type, std::string results_path, const bool luma_only) {
+    // Convolve the luma plane only.
+    const Image luma = image.get_luma(); // Luma of the input image.
+    const Image output_luma = convolve(luma, kernel, padding_type, results_path); // Convolved luma.
+
+    // Restore the chroma of the input image if required.
+    return luma_only ? output_luma : image.with_luma(output_luma);
+}
+
+Image Sequential::Convolution::convolve_pipeline(const Image& image, const std::vector<Kernel>& stages, PaddingType padding_type, std::string results_path, const uint32_t channel_mask, const bool separable) {
+    // Collapse the linear stages into one equivalent kernel.
+    const Kernel kernel = Kernel::compose(stages); // Collapsed kernel.
+    if (VERBOSITY >= 1) std::cout << "Collapsed " << stages.size() << " stages into a " << kernel.get_width() << "x" << kernel.get_height() << " kernel" << (separable && kernel.get_properties()->is_separable ? " (separable)" : "") << "." << std::endl;
+
+    // Apply non-separable kernels with the 2D engines.
+    if (!separable || !kernel.get_properties()->is_separable) {
+        return convolve(image, kernel, padding_type, results_path, channel_mask);
+    }
+
+    // Get the input image dimensions.
+    const int width = image.get_width(); // Image width.
+    const int height = image.get_height(); // Image height.
+    const int channels = image.get_channels(); // Image channels.
+
+
+    // Apply padding to the convolved channels of the input image.
+    const Image padded_image = image.padding(kernel.get_width() / 2, kernel.get_height() / 2, padding_type, channel_mask); // Padded image.
+
+    // Initialize the output image data (first touched by the threads writing its bands).
+    Image output_image = Image::uninitialized(width, height, channels, image.get_is_SoA()); // Output image.
+
+
+    // Print the execution information.
+    if (VERBOSITY >= 1) std::cout << "Starting sequential separable convolution..." << std::endl;
+
+    // Execution time.
+    float execution_time = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        // Start iteration execution time.
+        auto start_time = std::chrono::high_resolution_clock::now();
+        if (VERBOSITY >= 2) std::cout << "\tIteration: " << i;
+
+        // Convolve the image.
+        separable_convolution(image, kernel, padded_image, output_image, channel_mask);
+
+        // End iteration execution time.
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        // Measure the iteration execution time.
+        float iteration_execution_time = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+        execution_time += iteration_execution_time;
+
+        // Print the iteration execution time.
+        if (VERBOSITY >= 2) std::cout << " - Execution: " << iteration_execution_time << " ms" << std::endl;
+    }
+
+    // Print the execution time.
+    if (VERBOSITY >= 1) std::cout << "Execution time: " << execution_time / ITERATIONS << " ms (average of " << ITERATIONS << " runs)" << std::endl;
+
+
+    // Save the results.
+    if (!results_path.empty()) {
+        std::string execution_type = "separable";
+        save_results(results_path, execution_type, width, height, channels, image.get_is_SoA(), kernel.get_width(), kernel.get_height(), execution_time / ITERATIONS, ITERATIONS);
+    }
+
+
+    // Return the convolved image.
+    return output_image;
+}
+
+Image Sequential::Convolution::convolve_fused(const Image& image, const std::vector<PipelineStage>& stages, PaddingType padding_type, std::string results_path, const uint32_t channel_mask) {
+    // Get the input image dimensions.
+    const int width = image.get_width(); // Image width.
+    const int height = image.get_height(); // Image height.
+    const int channels = image.get_channels(); // Image channels.
+
+    // The input is padded once by the halo of the whole chain.
+    int halo = 0; // Sum of the stage radii.
+    for (const PipelineStage& stage : stages) { halo += stage.radius; }
+    const Image padded_image = image.padding(halo, halo, padding_type, channel_mask); // Padded image.
+
+    // Initialize the output image data (first touched by the threads writing its tiles).
+    Image output_image = Image::uninitialized(width, height, channels, image.get_is_SoA()); // Output image.
+
+
+    // Print the execution information.
+    if (VERBOSITY >= 1) std::cout << "Starting sequential fused pipeline of " << stages.size() << " stages..." << std::endl;
+
+    // Execution time.
+    float execution_time = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        // Start iteration execution time.
+        auto start_time = std::chrono::high_resolution_clock::now();
+        if (VERBOSITY >= 2) std::cout << "\tIteration: " << i;
+
+        // Filter the image.
+        fused_convolution(image, stages, padding_type, padded_image, output_image, channel_mask);
+
+        // End iteration execution time.
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        // Measure the iteration execution time.
+        float iteration_execution_time = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+        execution_time += iteration_execution_time;
+
+        // Print the iteration execution time.
+        if (VERBOSITY >= 2) std::cout << " - Execution: " << iteration_execution_time << " ms" << std::endl;
+    }
+
+    // Print the execution time.
+    if (VERBOSITY >= 1) std::cout << "Execution time: " << execution_time / ITERATIONS << " ms (average of " << ITERATIONS << " runs)" << std::endl;
+
+
+    // Save the results.
+    if (!results_path.empty()) {
+        std::string execution_type = "fused";
+        save_results(results_path, execution_type, width, height, channels, image.get_is_SoA(), 2 * halo + 1, 2 * halo + 1, execution_time / ITERATIONS, ITERATIONS);
+    }
+
+
+    // Return the filtered image.
+    return output_image;
+}
+
+Image Sequential::Convolution::convolve_iterated(const Image& image, const Kernel& kernel, const int iterations, PaddingType padding_type, std::string results_path, const uint32_t channel_mask) {
+    // Check if the number of applications is valid.
+    if (iterations < 1) {
+        std::cerr << "Error: The number of iterations must be at least 1." << std::endl;
+        throw std::invalid_argument("Invalid number of iterations.");
+    }
+
+    // Get the input image dimensions.
+    const int width = image.get_width(); // Image width.
+    const int height = image.get_height(); // Image height.
+    const int channels = image.get_channels(); // Image channels.
+
+    // The input is padded once by the halo of all the applications.
+    const Image padded_image = image.padding(iterations * (kernel.get_width() / 2), iterations * (kernel.get_height() / 2), padding_type, channel_mask); // Padded image.
+
+    // Initialize the output image data (first touched by the threads writing its tiles).
+    Image output_image = Image::uninitialized(width, height, channels, image.get_is_SoA()); // Output image.
+
+
+    // Print the execution information.
+    if (VERBOSITY >= 1) std::cout << "Starting sequential iterated convolution of " << iterations << " applications..." << std::endl;
+
+    // Execution time.
+    float execution_time = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        // Start iteration execution time.
+        auto start_time = std::chrono::high_resolution_clock::now();
+        if (VERBOSITY >= 2) std::cout << "\tIteration: " << i;
+
+        // Convolve the image.
+        iterated_convolution(image, kernel, iterations, padding_type, padded_image, output_image, channel_mask);
+
+        // End iteration execution time.
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        // Measure the iteration execution time.
+        float iteration_execution_time = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+        execution_time += iteration_execution_time;
+
+        // Print the iteration execution time.
+        if (VERBOSITY >= 2) std::cout << " - Execution: " << iteration_execution_time << " ms" << std::endl;
+    }
+
+    // Print the execution time.
+    if (VERBOSITY >= 1) std::cout << "Execution time: " << execution_time / ITERATIONS << " ms (average of " << ITERATIONS << " runs)" << std::endl;
+
+
+    // Save the results.
+    if (!results_path.empty()) {
+        std::string execution_type = "iterated";
+        save_results(results_path, execution_type, width, height, channels, image.get_is_SoA(), kernel.get_width(), kernel.get_height(), execution_time / ITERATIONS, ITERATIONS);
+    }
+
+
+    // Return the convolved image.
+    return output_image;
+}
+
+Image Sequential::Convolution::convolve_gaussian(const Image& image, const float sigma, PaddingType padding_type, std::string results_path, const uint32_t channel_mask, const GaussianMethod method) {
+    // Check if the standard deviation is valid.
+    if (!(sigma >= 0.5f)) {
+        std::cerr << "Error: The standard deviation of the gaussian must be at least 0.5." << std::endl;
+        throw std::invalid_argument("Invalid standard deviation.");
+    }
+
+    // Get the input image dimensions.
+    const int width = image.get_width(); // Image width.
+    const int height = image.get_height(); // Image height.
+    const int channels = image.get_channels(); // Image channels.
+
+    // The input is padded by the margin of the approximation.
+    const GaussianFilter filter(sigma, method, padding_type); // Gaussian approximation.
+    const int margin = filter.margin; // Margin of the approximation.
+    const Image padded_image = image.padding(margin, margin, padding_type, channel_mask); // Padded image.
+
+    // Initialize the output image data (first touched by the threads writing its rows).
+    Image output_image = Image::uninitialized(width, height, channels, image.get_is_SoA()); // Output image.
+
+
+    // Print the execution information.
+    if (VERBOSITY >= 1) {
+        const GaussianError error = get_gaussian_error(sigma, method); // Error of the approximation.
+        std::cout << "Starting sequential " << ((method == BOX_GAUSSIAN) ? "box" : "recursive") << " gaussian blur (sigma " << sigma << ")..." << std::endl;
+        std::cout << "Maximum error against the exact kernel: " << error.max_error << " (at most " << error.level_bound << " levels)" << std::endl;
+    }
+
+    // Execution time.
+    float execution_time = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        // Start iteration execution time.
+        auto start_time = std::chrono::high_resolution_clock::now();
+        if (VERBOSITY >= 2) std::cout << "\tIteration: " << i;
+
+        // Blur the image.
+        gaussian_blur(image, sigma, method, padding_type, padded_image, output_image, channel_mask);
+
+        // End iteration execution time.
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        // Measure the iteration execution time.
+        float iteration_execution_time = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+        execution_time += iteration_execution_time;
+
+        // Print the iteration execution time.
+        if (VERBOSITY >= 2) std::cout << " - Execution: " << iteration_execution_time << " ms" << std::endl;
+    }
+
+    // Print the execution time.
+    if (VERBOSITY >= 1) std::cout << "Execution time: " << execution_time / ITERATIONS << " ms (average of " << ITERATIONS << " runs)" << std::endl;
+
+
+    // Save the results.
+    if (!results_path.empty()) {
+        std::string execution_type = (method == BOX_GAUSSIAN) ? "box" : "recursive";
+        save_results(results_path, execution_type, width, height, channels, image.get_is_SoA(), 2 * filter.radius + 1, 2 * filter.radius + 1, execution_time / ITERATIONS, ITERATIONS);
+    }
+
+
+    // Return the blurred image.
+    return output_image;
+}
+
+Sequential::GaussianError Sequential::Convolution::get_gaussian_error(const float sigma, const GaussianMethod method) {
+    // Check if the standard deviation is valid.
+    if (!(sigma >= 0.5f)) {
+        std::cerr << "Error: The standard deviation of the gaussian must be at least 0.5." << std::endl;
+        throw std::invalid_argument("Invalid standard deviation.");
+    }
+
+    // Impulse response of the approximation along a line (the other lines of the block are empty), surrounded by its margin.
+    const GaussianFilter filter(sigma, method, PaddingType::ZERO); // Gaussian approximation.
+    const int radius = std::max((int)std::ceil(6.0f * sigma), filter.radius); // Radius of the compared responses.
+    const int length = 2 * radius + 1; // Length of the compared responses.
+    std::vector<float> block((size_t)(length + 2 * filter.margin) * RECURSIVE_LANES, 0.0f), scratch(block.size()); // Filtered lines.
+    block[(size_t)(radius + filter.margin) * RECURSIVE_LANES] = 1.0f;
+    filter.filter_lines(block.data(), scratch.data(), length + 2 * filter.margin, RECURSIVE_LANES);
+
+    // Exact gaussian, normalised over the same support.
+    std::vector<double> response(length), exact(length); // 1D responses.
+    double sum = 0; // Sum of the exact weights.
+    for (int i = 0; i < length; i++) {
+        response[i] = block[(size_t)(i + filter.margin) * RECURSIVE_LANES];
+        exact[i] = std::exp(-(double)(i - radius) * (i - radius) / (2.0 * sigma * sigma));
+        sum += exact[i];
+    }
+    for (int i = 0; i < length; i++) { exact[i] /= sum; }
+
+    // Compare the 2D responses (products of the 1D ones, since both filters are separable).
+    GaussianError error; // Error of the approximation.
+    double total = 0; // Sum of the differences.
+    for (int i = 0; i < length; i++) {
+        for (int j = 0; j < length; j++) {
+            const double difference = std::fabs(response[i] * response[j] - exact[i] * exact[j]); // Response difference.
+            error.max_error = std::max(error.max_error, difference);
+            total += difference;
+        }
+    }
+    error.level_bound = 255.0 * total;
+
+    return error;
+}
+
+std::vector<Image> Sequential::Convolution::convolve_bank(const Image& image, const std::vector<Kernel>& kernels, PaddingType padding_type, std::string results_path) {
+    const int channels = image.get_channels(); // Image channels.
+    const size_t pixels = (size_t)image.get_width() * image.get_height(); // Number of pixels.
+
+    // Output images, in the architecture of the input image.
+    std::vector<Image> output_images; // Output images.
+    std::vector<uint8_t*> outputs; // First output pixel of each kernel and channel.
+    for (size_t k = 0; k < kernels.size(); k++) {
+        output_images.push_back(Image::uninitialized(image.get_width(), image.get_height(), channels, image.get_is_SoA()));
+        uint8_t* output_data = output_images.back().get_data(); // Output image data.
+        for (int channel = 0; channel < channels; channel++) {
+            outputs.push_back(output_data + (image.get_is_SoA() ? channel * pixels : channel));
+        }
+    }
+
+    bank_convolution(image, kernels, padding_type, results_path, outputs, image.get_is_SoA() ? 1 : channels);
+
+    return output_images;
+}
+
+Image Sequential::Convolution::convolve_features(const Image& image, const std::vector<Kernel>& kernels, PaddingType padding_type, std::string results_path) {
+    const int channels = image.get_channels(); // Image channels.
+    const int features = (int)kernels.size() * channels; // Feature image channels.
+    const size_t pixels = (size_t)image.get_width() * image.get_height(); // Number of pixels.
+
+    // Feature image, in the architecture of the input image.
+    Image feature_image = Image::uninitialized(image.get_width(), image.get_height(), std::max(1, features), image.get_is_SoA()); // Feature image.
+    uint8_t* feature_data = feature_image.get_data(); // Feature image data.
+    std::vector<uint8_t*> outputs; // First output pixel of each kernel and channel.
+    for (int feature = 0; feature < features; feature++) {
+        outputs.push_back(feature_data + (image.get_is_SoA() ? feature * pixels : feature));
+    }
+
+    bank_convolution(image, kernels, padding_type, results_path, outputs, image.get_is_SoA() ? 1 : features);
+
+    return feature_image;
+}
+
+std::vector<Image> Sequential::Convolution::convolve_batch(const std::vector<Image>& images, const Kernel& kernel, PaddingType padding_type, const uint32_t channel_mask) {
+    ThreadPool& pool = ThreadPool::get_instance(); // CPU thread pool.
+    std::vector<Image> output_images(images.size(), Image(1, 1, 1)); // Output images.
+
+    // Images too small to keep every thread busy with their rows are convolved in parallel with each other.
+    const size_t small_size = (size_t)BAND_SIZE * pool.get_thread_count(); // Size in bytes below which an image is small.
+    std::vector<int> small_images, large_images; // Indices of the small and large images.
+    for (int i = 0; i < (int)images.size(); i++) {
+        (images[i].get_size() < small_size ? small_images : large_images).push_back(i);
+    }
+
+    // Plan of each image dimensions and architecture.
+    typedef std::map<std::tuple<int, int, int, bool>, std::unique_ptr<ConvolutionPlan>> Plans;
+    auto get_plan = [&](Plans& plans, const Image& image) -> ConvolutionPlan& {
+        const std::tuple<int, int, int, bool> key(image.get_width(), image.get_height(), image.get_channels(), image.get_is_SoA()); // Plan key.
+        std::unique_ptr<ConvolutionPlan>& plan = plans[key];
+        if (!plan) { plan.reset(new ConvolutionPlan(image.get_width(), image.get_height(), image.get_channels(), image.get_is_SoA(), kernel, padding_type, channel_mask)); }
+        return *plan;
+    };
+
+
+    // Print the execution information.
+    if (VERBOSITY >= 1) std::cout << "Starting sequential batch convolution of " << images.size() << " images..." << std::endl;
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    // Convolve the large images one at a time, each over parallel row bands.
+    Plans large_plans; // Plans of the large images.
+    for (const int i : large_images) {
+        get_plan(large_plans, images[i]).execute(images[i], output_images[i]);
+    }
+
+    // Convolve the small images in parallel, in bands of images (their row bands run inline on the thread of the band).
+    const int band_images = std::max(1, (int)small_images.size() / (pool.get_thread_count() * 4)); // Images per band.
+    pool.parallel_for((int)small_images.size(), band_images, [&](const int begin, const int end) {
+        Plans plans; // Plans of the band, sharing their scratch images across the images of the band.
+        for (int j = begin; j < end; j++) {
+            const int i = small_images[j]; // Image index.
+            get_plan(plans, images[i]).execute(images[i], output_images[i]);
+        }
+    });
+
+    // Print the execution time.
+    auto end_time = std::chrono::high_resolution_clock::now();
+    const float execution_time = std::chrono::duration<float, std::milli>(end_time - start_time).count(); // Batch execution time.
+    if (VERBOSITY >= 1) std::cout << "Execution time: " << execution_time << " ms (" << execution_time / std::max((size_t)1, images.size()) << " ms per image)" << std::endl;
+
+    // Return the convolved images.
+    return output_images;
+}
+
+void Sequential::Convolution::set_band_size(const int band_size) {
+    Sequential::Convolution::band_size = std::max(1, band_size);
+}
+
+int Sequential::Convolution::get_band_size() {
+    return band_size;
+}
+
+void Sequential::Convolution::convolution(const Image& image, const std::vector<const Kernel*>& kernels, const Image& padded_image, Image& output_image) {
+    // Get the input image dimensions.
+    const int width = image.get_width(); // Image width.
+    const int height = image.get_height(); // Image height.
+    const int channels = image.get_channels(); // Image channels.
+
+    // Get the padded image dimensions.
+    const int padded_width = padded_image.get_width(); // Padded image width.
+    const int padded_height = padded_image.get_height(); // Padded image height.
+
+
+    // Get padding dimensions.
+    const int padding_width = (padded_width - width) / 2; // Padding width.
+    const int padding_height = (padded_height - height) / 2; // Padding height.
+
+
+    // Get the output image data (every channel is written below).
+    uint8_t* output_data = output_image.get_data(); // Output image data.
+    const size_t pixels = (size_t)width * height; // Number of pixels.
+    const int output_stride = image.get_is_SoA() ? 1 : channels; // Distance between the pixels of a channel.
+
+    // The row based engines read contiguous channel planes of the padded image (converted once and cached).
+    const Image padded_planes = padded_image.converted(true); // Padded image in SoA layout.
+    const size_t padded_pixels = (size_t)padded_width * padded_height; // Number of padded pixels.
+
+
+    // The green and blue channels of grayscale images are copies of the red one when they share its kernel.
+    const bool is_grayscale = image.get_is_grayscale() && kernels[1] == kernels[0] && kernels[2] == kernels[0]; // Whether only the first color channel is convolved.
+
+
+    // Row functions compiled for the kernels (cached by kernel hash, so repeated calls reuse them), except the ones of the direct engine.
+    std::vector<JitRow> jit_rows(channels); // Row function of each channel.
+    if (USE_JIT && Jit::is_supported()) {
+        for (int channel = 0; channel < channels; channel++) {
+            if (kernels[channel] != NULL && !is_direct_kernel(*kernels[channel], *kernels[channel]->get_properties())) { jit_rows[channel] = Jit::compile(*kernels[channel], padded_width); }
+        }
+    }
+
+
+    // Iterate over the image in bands of rows, processed by the CPU threads.
+    const int band_rows = std::max(1, band_size / std::max(1, width * channels)); // Rows per band.
+    ThreadPool::get_instance().parallel_for(height, band_rows, [&](const int begin, const int end) {
+        std::vector<float> values(width); // Output values of a row.
+
+        for (int channel = 0; channel < channels; channel++) {
+            // Get the channel kernel.
+            const Kernel* kernel = kernels[channel];
+
+            // Skip the channels without kernel (copied through below) and the replicated channels.
+            if (kernel == NULL || (is_grayscale && (channel == 1 || channel == 2))) { continue; }
+
+            // The clamp is skipped when the kernel output provably fits the [0, 255] range.
+            const std::shared_ptr<const KernelProperties> properties = kernel->get_properties(); // Kernel properties.
+            const bool is_output_in_range = properties->is_output_in_range;
+
+            // Output channel.
+            uint8_t* output = output_data + (image.get_is_SoA() ? channel * pixels : channel);
+
+            const uint8_t* input = padded_planes.get_data() + channel * padded_pixels; // Padded channel plane.
+
+#if ISA_DISPATCH
+            // Mid-size dense kernels: blocks of output rows accumulated in vector registers by the direct engine.
+            if (is_direct_kernel(*kernel, *properties)) {
+                const int top = padding_height - kernel->get_height() / 2, left = padding_width - kernel->get_width() / 2; // Offset of the top-left tap of the first pixel.
+                direct_band(input + (size_t)top * padded_width + left, padded_width, padded_height - top, *kernel, begin, end, output, output_stride, width);
+                continue;
+            }
+#endif
+
+            // Iterate over the (folded) non-zero taps, a row at a time, with the compiled row function or the row primitives of the
+            // active instruction set.
+            for (int y = begin; y < end; y++) {
+                compiled_row(jit_rows[channel], input + (size_t)(y + padding_height) * padded_width + padding_width, padded_width, properties->tap_groups, values.data(), width);
+                store_row(values.data(), output + (size_t)y * width * output_stride, output_stride, width, is_output_in_range);
+            }
+        }
+    });
+
+    // Copy the channels without kernel through.
+    for (int channel = 0; channel < channels; channel++) {
+        if (kernels[channel] == NULL) { output_image.copy_channel(image, channel, channel); }
+    }
+
+    // Replicate the convolved channel of grayscale images.
+    if (is_grayscale) {
+        output_image.copy_channel(output_image, 0, 1);
+        output_image.copy_channel(output_image, 0, 2);
+    }
+}
+
+void Sequential::Convolution::separable_convolution(const Image& image, const Kernel& kernel, const Image& padded_image, Image& output_image, const uint32_t channel_mask) {
+    // Get the input image dimensions.
+    const int width = image.get_width(); // Image width.
+    const int height = image.get_height(); // Image height.
+    const int channels = image.get_channels(); // Image channels.
+
+    // Get the padded image dimensions.
+    const int padded_width = padded_image.get_width(); // Padded image width.
+    const size_t padded_pixels = (size_t)padded_width * padded_image.get_height(); // Number of padded pixels.
+
+
+    // Get the output image data (every channel is written below).
+    uint8_t* output_data = output_image.get_data(); // Output image data.
+    const size_t pixels = (size_t)width * height; // Number of pixels.
+    const int output_stride = image.get_is_SoA() ? 1 : channels; // Distance between the pixels of a channel.
+
+    // The 1D passes read contiguous channel planes of the padded image.
+    const Image padded_planes = padded_image.converted(true); // Padded image in SoA layout.
+
+    // Get the separable factors of the kernel.
+    const std::shared_ptr<const KernelProperties> properties = kernel.get_properties(); // Kernel properties.
+
+
+    // The green and blue channels of grayscale images are copies of the red one.
+    const bool is_grayscale = image.get_is_grayscale() && is_channel_selected(channel_mask, 0) && is_channel_selected(channel_mask, 1) && is_channel_selected(channel_mask, 2); // Whether only the first color channel is convolved.
+
+
+    // Iterate over the image in bands of rows, processed by the CPU threads.
+    const int band_rows = std::max(1, band_size / std::max(1, width * channels)); // Rows per band.
+    ThreadPool::get_instance().parallel_for(height, band_rows, [&](const int begin, const int end) {
+        std::vector<float> column_values(padded_width); // Vertically combined values of a padded row.
+        std::vector<float> values(width); // Output values of a row.
+
+        for (int channel = 0; channel < channels; channel++) {
+            // Skip the channels copied through below and the replicated channels.
+            if (!is_channel_selected(channel_mask, channel) || (is_grayscale && (channel == 1 || channel == 2))) { continue; }
+
+            const uint8_t* input = padded_planes.get_data() + channel * padded_pixels; // Padded channel plane.
+            uint8_t* output = output_data + (image.get_is_SoA() ? channel * pixels : channel); // Output channel.
+
+            for (int y = begin; y < end; y++) {
+                separable_row(input + (size_t)y * padded_width, padded_width, properties->column_vector, properties->row_vector, column_values.data(), values.data(), width);
+                store_row(values.data(), output + (size_t)y * width * output_stride, output_stride, width, properties->is_output_in_range);
+            }
+        }
+    });
+
+    // Copy the channels without kernel through.
+    for (int channel = 0; channel < channels; channel++) {
+        if (!is_channel_selected(channel_mask, channel)) { output_image.copy_channel(image, channel, channel); }
+    }
+
+    // Replicate the convolved channel of grayscale images.
+    if (is_grayscale) {
+        output_image.copy_channel(output_image, 0, 1);
+        output_image.copy_channel(output_image, 0, 2);
+    }
+}
+
+void Sequential::Convolution::fused_convolution(const Image& image, const std::vector<PipelineStage>& stages, const PaddingType padding_type, const Image& padded_image, Image& output_image, const uint32_t channel_mask) {
+    // Get the input image dimensions.
+    const int width = image.get_width(); // Image width.
+    const int height = image.get_height(); // Image height.
+    const int channels = image.get_channels(); // Image channels.
+
+    // Get the padded image dimensions.
+    const int padded_width = padded_image.get_width(); // Padded image width.
+    const size_t padded_pixels = (size_t)padded_width * padded_image.get_height(); // Number of padded pixels.
+    const int halo = (padded_width - width) / 2; // Sum of the stage radii.
+
+    // Source index of the positions around the image read by the intermediate stages (-1 for zero padding).
+    const std::vector<int> column_table = Image::padding_table(width, halo, padding_type); // Source column of each padded column.
+    const std::vector<int> row_table = Image::padding_table(height, halo, padding_type); // Source row of each padded row.
+
+
+    // Get the output image data (every channel is written below).
+    uint8_t* output_data = output_image.get_data(); // Output image data.
+    const size_t pixels = (size_t)width * height; // Number of pixels.
+    const int output_stride = image.get_is_SoA() ? 1 : channels; // Distance between the pixels of a channel.
+
+    // The stages read contiguous channel planes of the padded image.
+    const Image padded_planes = padded_image.converted(true); // Padded image in SoA layout.
+
+
+    // Iterate over the rows of tiles, processed by the CPU threads.
+    const int tile_size = FUSED_TILE_SIZE; // Size of the output tiles.
+    const int scratch_size = tile_size + 2 * halo; // Size of the largest intermediate tile.
+    ThreadPool::get_instance().parallel_for((height + tile_size - 1) / tile_size, 1, [&](const int begin, const int end) {
+        std::vector<uint8_t> scratch[2] = {std::vector<uint8_t>((size_t)scratch_size * scratch_size), std::vector<uint8_t>((size_t)scratch_size * scratch_size)}; // Intermediate tiles.
+        std::vector<float> values(scratch_size); // Output values of a row.
+
+        for (int tile_row = begin; tile_row < end; tile_row++) {
+            const int y0 = tile_row * tile_size; // First row of the tile.
+            const int tile_height = std::min(tile_size, height - y0); // Tile height.
+
+            for (int x0 = 0; x0 < width; x0 += tile_size) {
+                const int tile_width = std::min(tile_size, width - x0); // Tile width.
+
+                for (int channel = 0; channel < channels; channel++) {
+                    if (!is_channel_selected(channel_mask, channel)) { continue; }
+
+                    // The first stage reads the padded channel plane, the next ones the intermediate tile of the previous one
+                    // (the input pixel (x, y) of the image is at row y - input_top and column x - input_left).
+                    const uint8_t* input = padded_planes.get_data() + channel * padded_pixels; // Stage input.
+                    int input_width = padded_width; // Row stride of the stage input.
+                    int input_left = -halo, input_top = -halo; // Image position of the stage input.
+                    int margin = halo; // Halo around the tile still to be consumed by the next stages.
+
+                    for (size_t s = 0; s < stages.size(); s++) {
+                        const PipelineStage& stage = stages[s];
+                        margin -= stage.radius;
+                        const bool is_last = (s + 1 == stages.size()); // Whether the stage writes the output image.
+                        const bool is_output_in_range = (stage.operation != PipelineStage::CONVOLUTION) || stage.kernel->get_properties()->is_output_in_range;
+
+                        // Region of the stage output (the tile surrounded by the halo of the next stages), and its part inside the
+                        // image (the rest is padding).
+                        const int left = x0 - margin, right = x0 + tile_width + margin; // Region columns.
+                        const int top = y0 - margin, bottom = y0 + tile_height + margin; // Region rows.
+                        const int inner_left = std::max(left, 0), inner_right = std::min(right, width); // Inner columns.
+                        const int inner_top = std::max(top, 0), inner_bottom = std::min(bottom, height); // Inner rows.
+                        uint8_t* output = scratch[s % 2].data(); // Stage output.
+
+                        for (int y = inner_top; y < inner_bottom; y++) {
+                            stage_row(stage, input + (size_t)(y - input_top) * input_width + (inner_left - input_left), input_width, values.data(), inner_right - inner_left);
+                            if (is_last) {
+                                store_row(values.data(), output_data + (image.get_is_SoA() ? channel * pixels : channel) + ((size_t)y * width + inner_left) * output_stride, output_stride, inner_right - inner_left, is_output_in_range);
+                            } else {
+                                store_row(values.data(), output + (size_t)(y - top) * scratch_size + (inner_left - left), 1, inner_right - inner_left, is_output_in_range);
+                            }
+                        }
+                        if (is_last) { break; }
+
+                        // Pad the intermediate tile at the image borders from its inner part, as the next stage pads its input.
+                        for (int y = inner_top; y < inner_bottom; y++) {
+                            uint8_t* row = output + (size_t)(y - top) * scratch_size; // Intermediate row.
+                            for (int x = left; x < right; x++) {
+                                if (x == inner_left) { x = inner_right - 1; continue; } // Skip the inner columns.
+                                const int source = column_table[x + halo]; // Source column.
+                                row[x - left] = (source < 0) ? 0 : row[source - left];
+                            }
+                        }
+                        for (int y = top; y < bottom; y++) {
+                            if (y >= inner_top && y < inner_bottom) { continue; }
+                            const int source = row_table[y + halo]; // Source row.
+                            uint8_t* row = output + (size_t)(y - top) * scratch_size; // Intermediate row.
+                            if (source < 0) {
+                                memset(row, 0, right - left);
+                            } else {
+                                memcpy(row, output + (size_t)(source - top) * scratch_size, right - left);
+                            }
+                        }
+
+                        input = output;
+                        input_width = scratch_size;
+                        input_left = left;
+                        input_top = top;
+                    }
+
+                    // Without stages, the tile is copied from the padded plane.
+                    if (stages.empty()) {
+                        for (int y = 0; y < tile_height; y++) {
+                            for (int x = 0; x < tile_width; x++) {
+                                output_data[(image.get_is_SoA() ? channel * pixels : channel) + ((size_t)(y0 + y) * width + x0 + x) * output_stride] = input[(size_t)(y0 + y + halo) * padded_width + x0 + x + halo];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    // Copy the unselected channels through.
+    for (int channel = 0; channel < channels; channel++) {
+        if (!is_channel_selected(channel_mask, channel)) { output_image.copy_channel(image, channel, channel); }
+    }
+}
+
+
+void Sequential::Convolution::iterated_convolution(const Image& image, const Kernel& kernel, const int iterations, const PaddingType padding_type, const Image& padded_image, Image& output_image, const uint32_t channel_mask) {
+    // Get the input image dimensions.
+    const int width = image.get_width(); // Image width.
+    const int height = image.get_height(); // Image height.
+    const int channels = image.get_channels(); // Image channels.
+
+    // Get the kernel radii.
+    const int radius_x = kernel.get_width() / 2; // Horizontal kernel radius.
+    const int radius_y = kernel.get_height() / 2; // Vertical kernel radius.
+    const std::shared_ptr<const KernelProperties> properties = kernel.get_properties(); // Kernel properties.
+
+    // Get the padded image dimensions.
+    const int padded_width = padded_image.get_width(); // Padded image width.
+    const size_t padded_pixels = (size_t)padded_width * padded_image.get_height(); // Number of padded pixels.
+    const int halo_x = iterations * radius_x, halo_y = iterations * radius_y; // Padding of the image.
+
+    // Source index of the positions around the image read by the intermediate applications (-1 for zero padding).
+    const std::vector<int> column_table = Image::padding_table(width, halo_x, padding_type); // Source column of each padded column.
+    const std::vector<int> row_table = Image::padding_table(height, halo_y, padding_type); // Source row of each padded row.
+
+
+    // Get the output image data (every channel is written below).
+    uint8_t* output_data = output_image.get_data(); // Output image data.
+    const size_t pixels = (size_t)width * height; // Number of pixels.
+    const int output_stride = image.get_is_SoA() ? 1 : channels; // Distance between the pixels of a channel.
+
+    // The first application reads contiguous channel planes of the padded image.
+    const Image padded_planes = padded_image.converted(true); // Padded image in SoA layout.
+
+
+    // Size of the output tiles, and of the largest intermediate tile.
+    const int tile_size = ITERATED_TILE_SIZE; // Size of the output tiles.
+    const int scratch_width = tile_size + 2 * (iterations - 1) * radius_x; // Intermediate tile width.
+    const int scratch_height = tile_size + 2 * (iterations - 1) * radius_y; // Intermediate tile height.
+
+    // Row functions compiled for the padded image and the intermediate tiles (every application runs the row engine of convolution).
+    JitRow padded_row, scratch_row; // Compiled row functions.
+    if (USE_JIT && Jit::is_supported()) {
+        padded_row = Jit::compile(kernel, padded_width);
+        scratch_row = Jit::compile(kernel, scratch_width);
+    }
+
+
+    // Iterate over the rows of tiles, processed by the CPU threads.
+    ThreadPool::get_instance().parallel_for((height + tile_size - 1) / tile_size, 1, [&](const int begin, const int end) {
+        std::vector<uint8_t> scratch[2] = {std::vector<uint8_t>((size_t)scratch_width * scratch_height), std::vector<uint8_t>((size_t)scratch_width * scratch_height)}; // Intermediate tiles.
+        std::vector<float> values(scratch_width); // Output values of a row.
+
+        for (int tile_row = begin; tile_row < end; tile_row++) {
+            const int y0 = tile_row * tile_size; // First row of the tile.
+            const int tile_height = std::min(tile_size, height - y0); // Tile height.
+
+            for (int x0 = 0; x0 < width; x0 += tile_size) {
+                const int tile_width = std::min(tile_size, width - x0); // Tile width.
+
+                for (int channel = 0; channel < channels; channel++) {
+                    if (!is_channel_selected(channel_mask, channel)) { continue; }
+
+                    // The first application reads the padded channel plane, the next ones the intermediate tile of the previous one
+                    // (the input pixel (x, y) of the image is at row y - input_top and column x - input_left).
+                    const uint8_t* input = padded_planes.get_data() + channel * padded_pixels; // Application input.
+                    int input_width = padded_width; // Row stride of the application input.
+                    int input_left = -halo_x, input_top = -halo_y; // Image position of the application input.
+
+                    for (int i = 1; i <= iterations; i++) {
+                        const int margin = iterations - i; // Applications still to be run after this one.
+                        const bool is_last = (i == iterations); // Whether the application writes the output image.
+
+                        // Region of the application output (the tile surrounded by the halo of the next applications), and its part
+                        // inside the image (the rest is padding).
+                        const int left = x0 - margin * radius_x, right = x0 + tile_width + margin * radius_x; // Region columns.
+                        const int top = y0 - margin * radius_y, bottom = y0 + tile_height + margin * radius_y; // Region rows.
+                        const int inner_left = std::max(left, 0), inner_right = std::min(right, width); // Inner columns.
+                        const int inner_top = std::max(top, 0), inner_bottom = std::min(bottom, height); // Inner rows.
+                        uint8_t* output = scratch[i % 2].data(); // Application output.
+
+                        for (int y = inner_top; y < inner_bottom; y++) {
+                            compiled_row((i == 1) ? padded_row : scratch_row, input + (size_t)(y - input_top) * input_width + (inner_left - input_left), input_width, properties->tap_groups, values.data(), inner_right - inner_left);
+                            if (is_last) {
+                                store_row(values.data(), output_data + (image.get_is_SoA() ? channel * pixels : channel) + ((size_t)y * width + inner_left) * output_stride, output_stride, inner_right - inner_left, properties->is_output_in_range);
+                            } else {
+                                store_row(values.data(), output + (size_t)(y - top) * scratch_width + (inner_left - left), 1, inner_right - inner_left, properties->is_output_in_range);
+                            }
+                        }
+                        if (is_last) { break; }
+
+                        // Pad the intermediate tile at the image borders from its inner part, as the next application pads its input.
+                        for (int y = inner_top; y < inner_bottom; y++) {
+                            uint8_t* row = output + (size_t)(y - top) * scratch_width; // Intermediate row.
+                            for (int x = left; x < right; x++) {
+                                if (x == inner_left) { x = inner_right - 1; continue; } // Skip the inner columns.
+                                const int source = column_table[x + halo_x]; // Source column.
+                                row[x - left] = (source < 0) ? 0 : row[source - left];
+                            }
+                        }
+                        for (int y = top; y < bottom; y++) {
+                            if (y >= inner_top && y < inner_bottom) { continue; }
+                            const int source = row_table[y + halo_y]; // Source row.
+                            uint8_t* row = output + (size_t)(y - top) * scratch_width; // Intermediate row.
+                            if (source < 0) {
+                                memset(row, 0, right - left);
+                            } else {
+                                memcpy(row, output + (size_t)(source - top) * scratch_width, right - left);
+                            }
+                        }
+
+                        input = output;
+                        input_width = scratch_width;
+                        input_left = left;
+                        input_top = top;
+                    }
+                }
+            }
+        }
+    });
+
+    // Copy the unselected channels through.
+    for (int channel = 0; channel < channels; channel++) {
+        if (!is_channel_selected(channel_mask, channel)) { output_image.copy_channel(image, channel, channel); }
+    }
+}
+
+
+void Sequential::Convolution::gaussian_blur(const Image& image, const float sigma, const GaussianMethod method, const PaddingType padding_type, const Image& padded_image, Image& output_image, const uint32_t channel_mask) {
+    // Get the input image dimensions.
+    const int width = image.get_width(); // Image width.
+    const int height = image.get_height(); // Image height.
+    const int channels = image.get_channels(); // Image channels.
+
+    // Get the padded image dimensions.
+    const int padded_width = padded_image.get_width(); // Padded image width.
+    const int padded_height = padded_image.get_height(); // Padded image height.
+    const size_t padded_pixels = (size_t)padded_width * padded_height; // Number of padded pixels.
+    const GaussianFilter filter(sigma, method, padding_type); // Gaussian approximation.
+    const int margin = filter.margin; // Margin of the approximation.
+
+    // The image is blurred by column strips, each one filtered along its columns and then along its rows while it is in cache, so
+    // no intermediate image is materialised. The rows of a strip also read the radius of the approximation on both sides, so the
+    // strips are at least four radii wide (the overlaps are filtered twice, at most half the strip more).
+    const int strips = std::max(1, width / std::max(GAUSSIAN_STRIP_LANES * RECURSIVE_LANES, 4 * filter.radius)); // Strips of a channel.
+    const int inner_width = ((width + strips - 1) / strips + RECURSIVE_LANES - 1) / RECURSIVE_LANES * RECURSIVE_LANES; // Output columns of a strip.
+    const int strip_width = inner_width + (2 * filter.radius + RECURSIVE_LANES - 1) / RECURSIVE_LANES * RECURSIVE_LANES; // Columns of the strip buffers.
+
+    // The strips of every channel are processed in bands, sharing their scratch buffers.
+    ThreadPool& pool = ThreadPool::get_instance(); // Thread pool.
+    const int tasks = channels * strips; // Strips of the image.
+    const int band_tasks = std::max(1, tasks / (pool.get_thread_count() * 4)); // Strips per band.
+
+
+    // Get the output image data (every channel is written below).
+    uint8_t* output_data = output_image.get_data(); // Output image data.
+    const size_t pixels = (size_t)width * height; // Number of pixels.
+    const int output_stride = image.get_is_SoA() ? 1 : channels; // Distance between the pixels of a channel.
+
+    // The columns are filtered from contiguous channel planes of the padded image.
+    const Image padded_planes = padded_image.converted(true); // Padded image in SoA layout.
+
+    pool.parallel_for(tasks, band_tasks, [&](const int begin, const int end) {
+        std::vector<float> strip((size_t)padded_height * strip_width); // Columns of the strip.
+        std::vector<float> block((size_t)strip_width * RECURSIVE_LANES); // Interleaved rows of the strip.
+        std::vector<float> scratch((size_t)std::max(padded_height, strip_width) * RECURSIVE_LANES); // Scratch buffer of the lines.
+        std::vector<float> values((size_t)RECURSIVE_LANES * inner_width); // Output values of the rows.
+
+        for (int task = begin; task < end; task++) {
+            const int channel = task / strips; // Channel of the strip.
+            if (!is_channel_selected(channel_mask, channel)) { continue; }
+            const uint8_t* input = padded_planes.get_data() + channel * padded_pixels; // Padded channel plane.
+            uint8_t* output = output_data + (image.get_is_SoA() ? channel * pixels : channel); // Output channel.
+
+            // Output columns of the strip, and padded columns read by its rows.
+            const int x0 = (task % strips) * inner_width; // First output column.
+            const int count = std::min(inner_width, width - x0); // Output columns.
+            const int left = std::max(x0 - filter.radius, -margin) + margin; // First padded column.
+            const int right = std::min(x0 + count + filter.radius, width + margin) + margin; // Last padded column (excluded).
+            const int lanes = right - left; // Columns of the strip.
+
+            // Filter the columns of the strip, GAUSSIAN_STRIP_LANES blocks of lanes loaded and stored by contiguous runs of the rows.
+            for (int y = 0; y < padded_height; y++) {
+                const uint8_t* source = input + (size_t)y * padded_width + left; // Padded row of the strip.
+                float* samples = strip.data() + (size_t)y * strip_width; // Samples of the columns.
+                for (int r = 0; r < lanes; r++) { samples[r] = source[r]; }
+                for (int r = lanes; r < (lanes + RECURSIVE_LANES - 1) / RECURSIVE_LANES * RECURSIVE_LANES; r++) { samples[r] = source[lanes - 1]; }
+            }
+            for (int r = 0; r < lanes; r += RECURSIVE_LANES) {
+                filter.filter_lines(strip.data() + r, scratch.data(), padded_height, strip_width);
+            }
+
+            // Filter the rows of the strip, a block of lanes at a time, and store their output columns.
+            for (int y0 = 0; y0 < height; y0 += RECURSIVE_LANES) {
+                const int rows = std::min(RECURSIVE_LANES, height - y0); // Rows of the block.
+
+                // Interleave the rows (transposed by tiles of RECURSIVE_LANES columns, in the L1 cache).
+                const float* sources[RECURSIVE_LANES]; // Row of each lane.
+                for (int r = 0; r < RECURSIVE_LANES; r++) { sources[r] = strip.data() + (size_t)(y0 + std::min(r, rows - 1) + margin) * strip_width; }
+                for (int x = 0; x < lanes; x++) {
+                    float* samples = block.data() + (size_t)x * RECURSIVE_LANES; // Samples of the rows.
+                    for (int r = 0; r < RECURSIVE_LANES; r++) { samples[r] = sources[r][x]; }
+                }
+
+                filter.filter_lines(block.data(), scratch.data(), lanes, RECURSIVE_LANES);
+
+                // Deinterleave the output columns of the rows.
+                const float* samples = block.data() + (size_t)(x0 + margin - left) * RECURSIVE_LANES; // Samples of the output columns.
+                for (int r = 0; r < rows; r++) {
+                    float* target = values.data() + (size_t)r * inner_width; // Output values of the row.
+                    for (int x = 0; x < count; x++) { target[x] = samples[(size_t)x * RECURSIVE_LANES + r]; }
+                }
+                for (int r = 0; r < rows; r++) {
+                    store_row(values.data() + (size_t)r * inner_width, output + ((size_t)(y0 + r) * width + x0) * output_stride, output_stride, count, false);
+                }
+            }
+        }
+    });
+
+    // Copy the unselected channels through.
+    for (int channel = 0; channel < channels; channel++) {
+        if (!is_channel_selected(channel_mask, channel)) { output_image.copy_channel(image, channel, channel); }
+    }
+}
+
+
+// Expression terms.
+
+Sequential::ConvolutionTerm::ConvolutionTerm(const Image& image, const Kernel& kernel, const PaddingType padding_type)
+    : image(image), kernel(std::make_shared<const Kernel>(kernel)),
+      column_table(Image::padding_table(image.get_width(), kernel.get_width() / 2, padding_type)), row_table(Image::padding_table(image.get_height(), kernel.get_height() / 2, padding_type)) {
+}
+
+void Sequential::ConvolutionTerm::pad_row(const int channel, const int padded_y, uint8_t* output) const {
+    const int width = image.get_width(); // Image width.
+    const int padding_width = kernel->get_width() / 2; // Padding width.
+    const int padded_width = (int)column_table.size(); // Padded image width.
+    const int source_y = row_table[padded_y]; // Source row.
+
+    // Zero padded row.
+    if (source_y < 0) {
+        memset(output, 0, padded_width);
+        return;
+    }
+
+    // Samples of the source row (pixels apart in AoS architecture).
+    const int stride = image.get_is_SoA() ? 1 : image.get_channels(); // Distance between the samples of the row.
+    const uint8_t* source = image.get_data() + (image.get_is_SoA() ? ((size_t)channel * image.get_height() + source_y) * width : (size_t)source_y * width * stride + channel);
+
+    // Copy the inner columns, then the padding ones through the column table.
+    if (stride == 1) {
+        memcpy(output + padding_width, source, width);
+    } else {
+        for (int x = 0; x < width; x++) { output[padding_width + x] = source[(size_t)x * stride]; }
+    }
+    for (int x = 0; x < padding_width; x++) {
+        const int left = column_table[x], right = column_table[padded_width - 1 - x]; // Source columns of the padding.
+        output[x] = (left < 0) ? 0 : source[(size_t)left * stride];
+        output[padded_width - 1 - x] = (right < 0) ? 0 : source[(size_t)right * stride];
+    }
+}
+
+void Sequential::ConvolutionTerm::load_row(const int channel, const int y) {
+    const int width = image.get_width(); // Image width.
+    const int padded_width = (int)column_table.size(); // Padded image width.
+    const int kernel_height = kernel->get_height(); // Padded rows read by an output row.
+    const int capacity = 2 * kernel_height + 16; // Rows of the window (the kept rows are moved to its front when it is full).
+    window.resize((size_t)capacity * padded_width);
+
+    // Keep the padded rows already in the window (the output row y reads the padded rows y to y + kernel_height - 1).
+    if (channel != window_channel || y < window_first || y >= window_first + window_rows) {
+        window_channel = channel;
+        window_first = y;
+        window_rows = 0;
+    } else if (y + kernel_height > window_first + capacity) {
+        window_rows -= y - window_first;
+        memmove(window.data(), window.data() + (size_t)(y - window_first) * padded_width, (size_t)window_rows * padded_width);
+        window_first = y;
+    }
+
+    // Pad the missing rows.
+    for (; window_rows < y + kernel_height - window_first; window_rows++) {
+        pad_row(channel, window_first + window_rows, window.data() + (size_t)window_rows * padded_width);
+    }
+
+    values.resize(width);
+    const uint8_t* input = window.data() + (size_t)(y - window_first + kernel_height / 2) * padded_width + kernel->get_width() / 2; // Padded pixel of the first output pixel.
+    taps_row(input, padded_width, kernel->get_properties()->tap_groups, values.data(), width);
+}
+
+
+// Plan.
+
+Sequential::ConvolutionPlan::ConvolutionPlan(const int width, const int height, const int channels, const bool is_SoA, const std::vector<const Kernel*>& kernels, const PaddingType padding_type)
+    : width(width), height(height), channels(channels), is_SoA(is_SoA), padding_type(padding_type), planes(1, 1, 1), padded_image(1, 1, 1) {
+    // Check if there is a kernel entry for every channel.
+    if ((int)kernels.size() != channels) {
+        std::cerr << "Error: Expected " << channels << " channel kernels, got " << kernels.size() << "." << std::endl;
+        throw std::invalid_argument("Invalid number of channel kernels.");
+    }
+
+    // Copy the distinct kernels (sharing their analyzed properties) and point each channel to its copy.
+    kernel_copies.reserve(channels);
+    int kernel_width = 1, kernel_height = 1; // Largest kernel dimensions.
+    for (int channel = 0; channel < channels; channel++) {
+        const Kernel* kernel = kernels[channel];
+        if (kernel == NULL) {
+            this->kernels.push_back(NULL);
+            continue;
+        }
+
+        // Reuse the copy of a kernel shared with a previous channel (e.g. for the grayscale shortcut).
+        int previous = 0;
+        while (previous < channel && kernels[previous] != kernel) { previous++; }
+        if (previous < channel) {
+            this->kernels.push_back(this->kernels[previous]);
+        } else {
+            kernel_copies.push_back(*kernel);
+            this->kernels.push_back(&kernel_copies.back());
+        }
+
+        kernel_width = std::max(kernel_width, kernel->get_width());
+        kernel_height = std::max(kernel_height, kernel->get_height());
+        if (channel < 32) { channel_mask |= (1u << channel); }
+    }
+
+    // Compute the padding index tables.
+    const int padding_width = kernel_width / 2; // Padding width.
+    const int padding_height = kernel_height / 2; // Padding height.
+    column_table = Image::padding_table(width, padding_width, padding_type);
+    row_table = Image::padding_table(height, padding_height, padding_type);
+
+    // Allocate the scratch images (the row engines read SoA planes, which the generic loop reads as well).
+    if (!is_SoA) { planes = Image::uninitialized(width, height, channels, true); }
+    padded_image = Image::uninitialized(width + 2 * padding_width, height + 2 * padding_height, channels, true);
+}
+
+Sequential::ConvolutionPlan::ConvolutionPlan(const int width, const int height, const int channels, const bool is_SoA, const Kernel& kernel, const PaddingType padding_type, const uint32_t channel_mask)
+    : ConvolutionPlan(width, height, channels, is_SoA, [&] {
+        std::vector<const Kernel*> kernels(channels, NULL); // Kernel of each channel.
+        for (int channel = 0; channel < channels; channel++) {
+            if (is_channel_selected(channel_mask, channel)) { kernels[channel] = &kernel; }
+        }
+        return kernels;
+    }(), padding_type) {
+}
+
+void Sequential::ConvolutionPlan::execute(const Image& input, Image& output) {
+    // Check if the input image matches the plan.
+    if (input.get_width() != width || input.get_height() != height || input.get_channels() != channels || input.get_is_SoA() != is_SoA) {
+        std::cerr << "Error: The image does not match the convolution plan." << std::endl;
+        throw std::invalid_argument("Invalid image for the convolution plan.");
+    }
+
+    // Reallocate the output image only if needed.
+    if (output.get_width() != width || output.get_height() != height || output.get_channels() != channels || output.get_is_SoA() != is_SoA) {
+        output = Image::uninitialized(width, height, channels, is_SoA);
+    }
+
+    // Pad the SoA planes of the input into the scratch image.
+    if (is_SoA) {
+        input.padding_into(padded_image, column_table, row_table, padding_type, channel_mask);
+    } else {
+        Image::AoS_to_SoA(input.get_data(), planes.get_data(), width, height, channels);
+        planes.padding_into(padded_image, column_table, row_table, padding_type, channel_mask);
+    }
+
+    // Convolve the image.
+    Sequential::Convolution::convolution(input, kernels, padded_image, output);
+}
+
+void Sequential::Convolution::bank_convolution(const Image& image, const std::vector<Kernel>& kernels, PaddingType padding_type, std::string results_path, const std::vector<uint8_t*>& outputs, const int output_stride) {
+    // Get the input image dimensions.
+    const int width = image.get_width(); // Image width.
+    const int height = image.get_height(); // Image height.
+    const int channels = image.get_channels(); // Image channels.
+    const int kernel_count = (int)kernels.size(); // Number of kernels.
+    if (kernel_count == 0) { return; }
+
+    // Get the largest kernel dimensions, and the union of the non-zero taps with the weight of each kernel.
+    int kernel_width = 1, kernel_height = 1; // Kernel dimensions.
+    std::map<std::pair<int, int>, std::vector<std::pair<int, float>>> offsets; // Kernel weights by tap offset (row-major).
+    for (int k = 0; k < kernel_count; k++) {
+        kernel_width = std::max(kernel_width, kernels[k].get_width());
+        kernel_height = std::max(kernel_height, kernels[k].get_height());
+        for (const KernelTap& tap : kernels[k].get_properties()->taps) {
+            offsets[std::make_pair(tap.dy, tap.dx)].push_back(std::make_pair(k, tap.weight));
+        }
+    }
+
+    // Large dense banks are convolved as a matrix product of the packed weights (panels of GEMM_MR kernels) by the patches.
+    const int taps = kernel_width * kernel_height; // Taps of the largest kernel.
+    size_t tap_count = 0; // Number of non-zero taps of the kernels.
+    for (const auto& offset : offsets) { tap_count += offset.second.size(); }
+    const bool is_gemm = kernel_count >= GEMM_MIN_KERNELS && tap_count >= DENSE_MIN_DENSITY * kernel_count * taps; // Whether to use the matrix product.
+    std::vector<float> packed_weights; // Packed weights.
+    if (is_gemm) {
+        packed_weights.assign((size_t)(kernel_count + GEMM_MR - 1) / GEMM_MR * taps * GEMM_MR, 0.0f);
+        for (const auto& offset : offsets) {
+            const int t = (offset.first.first + kernel_height / 2) * kernel_width + offset.first.second + kernel_width / 2; // Tap of the largest kernel.
+            for (const std::pair<int, float>& weight : offset.second) {
+                packed_weights[((size_t)(weight.first / GEMM_MR) * taps + t) * GEMM_MR + weight.first % GEMM_MR] = weight.second;
+            }
+        }
+    }
+
+
+    // Apply padding to the input image and read its channel planes.
+    const int padding_width = kernel_width / 2; // Padding width.
+    const int padding_height = kernel_height / 2; // Padding height.
+    const Image padded_planes = image.padding(padding_width, padding_height, padding_type).converted(true); // Padded image in SoA layout.
+    const int padded_width = padded_planes.get_width(); // Padded image width.
+    const size_t padded_pixels = (size_t)padded_width * padded_planes.get_height(); // Number of padded pixels.
+
+
+    // Print the execution information.
+    if (VERBOSITY >= 1) std::cout << "Starting sequential filter bank convolution with " << kernel_count << " kernels" << (is_gemm ? " (im2col + GEMM)" : "") << "..." << std::endl;
+
+    // Execution time.
+    float execution_time = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        // Start iteration execution time.
+        auto start_time = std::chrono::high_resolution_clock::now();
+        if (VERBOSITY >= 2) std::cout << "\tIteration: " << i;
+
+        // Iterate over the image in bands of rows, processed by the CPU threads.
+        const int band_rows = std::max(1, band_size / std::max(1, width * channels * kernel_count)); // Rows per band.
+        ThreadPool::get_instance().parallel_for(height, band_rows, [&](const int begin, const int end) {
+            const int chunk_size = 64; // Pixels converted at once.
+            std::vector<float> values((size_t)kernel_count * width); // Output values of a row for each kernel.
+            float samples[chunk_size]; // Converted input samples.
+            std::vector<float> patches(is_gemm ? (size_t)taps * GEMM_NC : 0); // Patch matrix of the matrix product.
+
+            for (int channel = 0; channel < channels; channel++) {
+                const uint8_t* input = padded_planes.get_data() + channel * padded_pixels; // Padded channel plane.
+
+                for (int y = begin; y < end; y++) {
+                    if (is_gemm) {
+                        gemm_row(input + (size_t)y * padded_width, padded_width, kernel_width, kernel_height, packed_weights, kernel_count, values.data(), width, patches.data());
+                        for (int k = 0; k < kernel_count; k++) {
+                            store_row(values.data() + (size_t)k * width, outputs[k * channels + channel] + (size_t)y * width * output_stride, output_stride, width, kernels[k].get_properties()->is_output_in_range);
+                        }
+                        continue;
+                    }
+
+                    std::fill(values.begin(), values.end(), 0.0f);
+
+                    // Each input sample is converted once and accumulated into every kernel with a weight at its offset.
+                    for (const auto& offset : offsets) {
+                        const uint8_t* source = input + (size_t)(y + padding_height + offset.first.first) * padded_width + padding_width + offset.first.second; // Shifted input row.
+
+                        for (int x0 = 0; x0 < width; x0 += chunk_size) {
+                            const int count = std::min(chunk_size, width - x0); // Pixels in the chunk.
+                            for (int x = 0; x < count; x++) { samples[x] = source[x0 + x]; }
+
+                            for (const std::pair<int, float>& weight : offset.second) {
+                                float* kernel_values = values.data() + (size_t)weight.first * width + x0; // Output values of the kernel.
+                                const float w = weight.second; // Tap weight.
+
+                                #pragma omp simd
+                                for (int x = 0; x < count; x++) { kernel_values[x] += w * samples[x]; }
+                            }
+                        }
+                    }
+
+                    // Store the output rows.
+                    for (int k = 0; k < kernel_count; k++) {
+                        store_row(values.data() + (size_t)k * width, outputs[k * channels + channel] + (size_t)y * width * output_stride, output_stride, width, kernels[k].get_properties()->is_output_in_range);
+                    }
+                }
+            }
+        });
+
+        // End iteration execution time.
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        // Measure the iteration execution time.
+        float iteration_execution_time = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+        execution_time += iteration_execution_time;
+
+        // Print the iteration execution time.
+        if (VERBOSITY >= 2) std::cout << " - Execution: " << iteration_execution_time << " ms" << std::endl;
+    }
+
+    // Print the execution time.
+    if (VERBOSITY >= 1) std::cout << "Execution time: " << execution_time / ITERATIONS << " ms (average of " << ITERATIONS << " runs)" << std::endl;
+
+
+    // Save the results.
+    if (!results_path.empty()) {
+        std::string execution_type = "filter_bank";
+        save_results(results_path, execution_type, width, height, channels, image.get_is_SoA(), kernel_width, kernel_height, execution_time / ITERATIONS, ITERATIONS);
+    }
+}
@@ -2,12 +2,66 @@
 #define CONVOLUTION_SEQUENTIAL_H
 
 #include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <type_traits>
 
 #include "../image.h"
 #include "../kernel.h"
 
 
 namespace Sequential {
+    // Stage of a fused pipeline.
+    struct PipelineStage {
+        // Stage operations.
+        enum Operation { CONVOLUTION, MEDIAN, EROSION, DILATION };
+
+        // Stage operation.
+        Operation operation = CONVOLUTION;
+
+        // Kernel of the convolution stages.
+        std::shared_ptr<const Kernel> kernel;
+
+        // Radius of the stage window.
+        int radius = 0;
+
+
+        /*
+            * Create a convolution stage (clamped to [0, 255] before the next stage).
+            *
+            * @param kernel The kernel to be applied.
+            *
+            * @return The convolution stage.
+        */
+        static PipelineStage convolution(const Kernel& kernel);
+
+        /*
+            * Create a median, erosion (minimum) or dilation (maximum) stage over a square window.
+            *
+            * @param operation The stage operation.
+            * @param radius The radius of the window.
+            *
+            * @return The stage.
+        */
+        static PipelineStage window(const Operation operation, const int radius = 1);
+    };
+
+    // Gaussian approximation methods.
+    enum GaussianMethod {
+        RECURSIVE_GAUSSIAN, // 4th order recursive filter (within one level of the exact kernel).
+        BOX_GAUSSIAN // Successive box blurs (BOX_PASSES), for fast previews.
+    };
+
+    // Error of a gaussian approximation against the exact (sampled and normalised) 2D kernel.
+    struct GaussianError {
+        // Largest difference between the impulse responses.
+        double max_error = 0;
+
+        // Bound of the output difference on 8 bits images, in levels (255 times the sum of the impulse response differences).
+        double level_bound = 0;
+    };
+
     class Convolution {
         public:
             /*
@@ -17,24 +71,350 @@ namespace Sequential {
                 * @param kernel The kernel to be applied.
                 * @param padding_type The padding type to be applied.
                 * @param results_path The path to save the results.
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
+                * 
+                * @return The convolved image.
+            */
+            static Image convolve(const Image& image, const Kernel& kernel, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "", const uint32_t channel_mask = ALL_CHANNELS);
+
+            /*
+                * Convolve an image of any sample type and measure the execution time. 8 bits images are convolved by the engines
+                * of convolve, the other ones over the non-zero kernel taps, saturated to the range of their samples (float samples
+                * are never clamped, so that chained filters keep their precision).
+                *
+                * @param image The image to be convolved.
+                * @param kernel The kernel to be applied.
+                * @param padding_type The padding type to be applied.
+                * @param results_path The path to save the results.
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
                 * 
                 * @return The convolved image.
             */
-            static Image convolve(const Image& image, const Kernel& kernel, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "");
+            template <typename T>
+            static BasicImage<T> convolve_samples(const BasicImage<T>& image, const Kernel& kernel, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "", const uint32_t channel_mask = ALL_CHANNELS);
 
+            /*
+                * Convolve each channel of the image with its own kernel in the same pass and measure the execution time.
+                *
+                * @param image The image to be convolved.
+                * @param kernels The kernel of each channel (NULL to copy the channel through).
+                * @param padding_type The padding type to be applied.
+                * @param results_path The path to save the results.
+                * 
+                * @return The convolved image.
+            */
+            static Image convolve_channels(const Image& image, const std::vector<const Kernel*>& kernels, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "");
 
-        private:
             /*
-                * Applies convolution to the image.
+                * Convolve the luma (Y of YCbCr) of the image only, keeping its chroma, and measure the execution time.
+                *
+                * @param image The image to be convolved.
+                * @param kernel The kernel to be applied.
+                * @param padding_type The padding type to be applied.
+                * @param results_path The path to save the results.
+                * @param luma_only Whether to return the convolved luma only (e.g. for edge maps).
+                * 
+                * @return The convolved image.
+            */
+            static Image convolve_luma(const Image& image, const Kernel& kernel, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "", const bool luma_only = false);
+
+            /*
+                * Convolve the image with a chain of kernels collapsed into one equivalent kernel and measure the execution time
+                * (the intermediate clamps are dropped and the borders use the padding of the collapsed kernel).
+                *
+                * @param image The image to be convolved.
+                * @param stages The kernels, in the order in which they are applied.
+                * @param padding_type The padding type to be applied.
+                * @param results_path The path to save the results.
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
+                * @param separable Whether to apply a separable collapsed kernel as a vertical and a horizontal 1D pass.
+                * 
+                * @return The convolved image.
+            */
+            static Image convolve_pipeline(const Image& image, const std::vector<Kernel>& stages, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "", const uint32_t channel_mask = ALL_CHANNELS, const bool separable = false);
+
+            /*
+                * Apply a chain of stages tile by tile and measure the execution time: the intermediate tiles, with the halo
+                * read by the next stages, stay in per-thread scratch buffers instead of full images
+                * (each stage pads its input at the image borders, so the result equals the chained convolutions).
+                *
+                * @param image The image to be filtered.
+                * @param stages The stages, in the order in which they are applied.
+                * @param padding_type The padding type to be applied.
+                * @param results_path The path to save the results.
+                * @param channel_mask The channels to be filtered (the other ones are copied through, e.g. alpha).
+                * 
+                * @return The filtered image.
+            */
+            static Image convolve_fused(const Image& image, const std::vector<PipelineStage>& stages, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "", const uint32_t channel_mask = ALL_CHANNELS);
+
+            // The pipelines run on 8 bits images only: the other sample types are rejected at compile time (they are convolved by
+            // convolve_samples).
+            template <typename T>
+            static Image convolve_pipeline(const BasicImage<T>& image, const std::vector<Kernel>& stages, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "", const uint32_t channel_mask = ALL_CHANNELS, const bool separable = false) {
+                static_assert(std::is_same<T, uint8_t>::value, "Pipelines support 8 bits images only (use convolve_samples for the other sample types).");
+                return convolve_pipeline(image, stages, padding_type, results_path, channel_mask, separable);
+            }
+
+            template <typename T>
+            static Image convolve_fused(const BasicImage<T>& image, const std::vector<PipelineStage>& stages, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "", const uint32_t channel_mask = ALL_CHANNELS) {
+                static_assert(std::is_same<T, uint8_t>::value, "Fused pipelines support 8 bits images only (use convolve_samples for the other sample types).");
+                return convolve_fused(image, stages, padding_type, results_path, channel_mask);
+            }
+
+            /*
+                * Apply a kernel several times (clamping after each application) and measure the execution time: every tile
+                * runs all the applications in per-thread scratch buffers, from the input tile surrounded by a halo of
+                * iterations * radius pixels, so the intermediate images never leave the cache. The padding of each application
+                * is rebuilt from its input, so the result matches the repeated convolve calls (up to the
+                * fused multiply-add rounding of the direct engine, for dense kernels from DIRECT_MIN_SIZE).
                 *
                 * @param image The image to be convolved.
                 * @param kernel The kernel to be applied.
-                * @param padded_image The padded image.
+                * @param iterations The number of applications of the kernel (at least 1).
+                * @param padding_type The padding type to be applied.
+                * @param results_path The path to save the results.
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
                 * 
                 * @return The convolved image.
+            */
+            static Image convolve_iterated(const Image& image, const Kernel& kernel, const int iterations, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "", const uint32_t channel_mask = ALL_CHANNELS);
+
+            /*
+                * Blur the image with a gaussian of any standard deviation and measure the execution time. The gaussian is
+                * approximated by the 4th order recursive filter of Deriche (a causal and an anticausal pass), or by successive box
+                * blurs with running sums, along the columns then the rows, over blocks of lines in vector lanes (all the passes of a
+                * block run while it is in cache), so the cost per pixel does not depend on sigma.
+                *
+                * @param image The image to be blurred.
+                * @param sigma The standard deviation of the gaussian (at least 0.5).
+                * @param padding_type The padding type to be applied.
+                * @param results_path The path to save the results.
+                * @param channel_mask The channels to be blurred (the other ones are copied through, e.g. alpha).
+                * @param method The approximation of the gaussian.
+                * 
+                * @return The blurred image.
+            */
+            static Image convolve_gaussian(const Image& image, const float sigma, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "", const uint32_t channel_mask = ALL_CHANNELS, const GaussianMethod method = RECURSIVE_GAUSSIAN);
+
+            /*
+                * Measure the error of the gaussian blur of convolve_gaussian against the exact kernel, from their impulse
+                * responses.
+                *
+                * @param sigma The standard deviation of the gaussian (at least 0.5).
+                * @param method The approximation of the gaussian.
+                * 
+                * @return The error of the approximation.
+            */
+            static GaussianError get_gaussian_error(const float sigma, const GaussianMethod method = RECURSIVE_GAUSSIAN);
+
+            /*
+                * Convolve the image with a bank of kernels in one pass (every input sample is loaded once for all the kernels)
+                * and measure the execution time.
+                *
+                * @param image The image to be convolved.
+                * @param kernels The kernels to be applied.
+                * @param padding_type The padding type to be applied.
+                * @param results_path The path to save the results.
+                * 
+                * @return The image convolved with each kernel.
+            */
+            static std::vector<Image> convolve_bank(const Image& image, const std::vector<Kernel>& kernels, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "");
+
+            /*
+                * Convolve the image with a bank of kernels in one pass and measure the execution time, writing a feature image.
+                *
+                * @param image The image to be convolved.
+                * @param kernels The kernels to be applied.
+                * @param padding_type The padding type to be applied.
+                * @param results_path The path to save the results.
+                * 
+                * @return The feature image, whose channel (k * channels + c) is the channel c convolved with the kernel k.
+            */
+            static Image convolve_features(const Image& image, const std::vector<Kernel>& kernels, PaddingType padding_type = PaddingType::ZERO, std::string results_path = "");
+
+            /*
+                * Convolve a batch of images (of the same or mixed dimensions) with the same kernel and measure the execution time.
+                * Large images are convolved one at a time over parallel row bands, while small ones are convolved in parallel,
+                * each thread reusing the scratch images of its plans across its images.
+                *
+                * @param images The images to be convolved.
+                * @param kernel The kernel to be applied.
+                * @param padding_type The padding type to be applied.
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
+                * 
+                * @return The convolved images.
+            */
+            static std::vector<Image> convolve_batch(const std::vector<Image>& images, const Kernel& kernel, PaddingType padding_type = PaddingType::ZERO, const uint32_t channel_mask = ALL_CHANNELS);
+
+            /*
+                * Set the size of the row bands processed by each CPU thread.
+                *
+                * @param band_size The band size in bytes (default: BAND_SIZE).
+            */
+            static void set_band_size(const int band_size);
+
+            /*
+                * Get the size of the row bands processed by each CPU thread.
+                *
+                * @return The band size in bytes.
+            */
+            static int get_band_size();
+
+
+        private:
+            // Size in bytes of the row bands processed by each CPU thread.
+            static int band_size;
+
+
+            /*
+                * Applies convolution to the image.
+                *
+                * @param image The image to be convolved.
+                * @param kernels The kernel of each channel (NULL to copy the channel through).
+                * @param padded_image The padded image (any architecture).
+                * @param output_image The output image, with the dimensions and architecture of the image (every channel is overwritten).
             
             */
-            static Image convolution(const Image& image, const Kernel& kernel, const Image& padded_image);
+            static void convolution(const Image& image, const std::vector<const Kernel*>& kernels, const Image& padded_image, Image& output_image);
+
+            /*
+                * Applies a separable kernel to the image as a vertical and a horizontal 1D pass per row.
+                *
+                * @param image The image to be convolved.
+                * @param kernel The separable kernel to be applied.
+                * @param padded_image The padded image (any architecture).
+                * @param output_image The output image, with the dimensions and architecture of the image (every channel is overwritten).
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
+            */
+            static void separable_convolution(const Image& image, const Kernel& kernel, const Image& padded_image, Image& output_image, const uint32_t channel_mask);
+
+            /*
+                * Applies a chain of stages to the image tile by tile.
+                *
+                * @param image The image to be filtered.
+                * @param stages The stages, in the order in which they are applied.
+                * @param padding_type The padding type, rebuilt around the intermediate tiles at the image borders.
+                * @param padded_image The image padded by the sum of the stage radii (any architecture).
+                * @param output_image The output image, with the dimensions and architecture of the image (every channel is overwritten).
+                * @param channel_mask The channels to be filtered (the other ones are copied through, e.g. alpha).
+            */
+            static void fused_convolution(const Image& image, const std::vector<PipelineStage>& stages, const PaddingType padding_type, const Image& padded_image, Image& output_image, const uint32_t channel_mask);
+
+            /*
+                * Applies a kernel several times to the image tile by tile.
+                *
+                * @param image The image to be convolved.
+                * @param kernel The kernel to be applied.
+                * @param iterations The number of applications of the kernel.
+                * @param padding_type The padding type, rebuilt around the intermediate tiles at the image borders.
+                * @param padded_image The image padded by iterations times the kernel radii (any architecture).
+                * @param output_image The output image, with the dimensions and architecture of the image (every channel is overwritten).
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
+            */
+            static void iterated_convolution(const Image& image, const Kernel& kernel, const int iterations, const PaddingType padding_type, const Image& padded_image, Image& output_image, const uint32_t channel_mask);
+
+            /*
+                * Blurs the image with an approximated gaussian.
+                *
+                * @param image The image to be blurred.
+                * @param sigma The standard deviation of the gaussian.
+                * @param method The approximation of the gaussian.
+                * @param padding_type The padding type of the padded image.
+                * @param padded_image The image padded by the margin of the approximation (any architecture).
+                * @param output_image The output image, with the dimensions and architecture of the image (every channel is overwritten).
+                * @param channel_mask The channels to be blurred (the other ones are copied through, e.g. alpha).
+            */
+            static void gaussian_blur(const Image& image, const float sigma, const GaussianMethod method, const PaddingType padding_type, const Image& padded_image, Image& output_image, const uint32_t channel_mask);
+
+            /*
+                * Applies a bank of kernels to the image in one pass and measure the execution time.
+                *
+                * @param image The image to be convolved.
+                * @param kernels The kernels to be applied.
+                * @param padding_type The padding type to be applied.
+                * @param results_path The path to save the results.
+                * @param outputs The first output pixel of each kernel (k) and channel (c), at index (k * channels + c).
+                * @param output_stride The distance between the output pixels of a channel.
+            */
+            static void bank_convolution(const Image& image, const std::vector<Kernel>& kernels, PaddingType padding_type, std::string results_path, const std::vector<uint8_t*>& outputs, const int output_stride);
+
+
+            // The plans run the convolution on their own scratch images.
+            friend class ConvolutionPlan;
+    };
+
+    class ConvolutionPlan {
+        public:
+            // Constructors.
+
+            /*
+                * Plan the convolution of images with fixed dimensions and architecture: the kernels, their properties, the padding
+                * index tables and the scratch images are prepared once and reused by every execution.
+                *
+                * @param width The width of the images.
+                * @param height The height of the images.
+                * @param channels The number of channels of the images.
+                * @param is_SoA Whether the images are in SoA architecture.
+                * @param kernels The kernel of each channel (NULL to copy the channel through).
+                * @param padding_type The padding type to be applied.
+            */
+            ConvolutionPlan(const int width, const int height, const int channels, const bool is_SoA, const std::vector<const Kernel*>& kernels, const PaddingType padding_type = PaddingType::ZERO);
+
+            /*
+                * Plan the convolution of images with fixed dimensions and architecture with a single kernel.
+                *
+                * @param width The width of the images.
+                * @param height The height of the images.
+                * @param channels The number of channels of the images.
+                * @param is_SoA Whether the images are in SoA architecture.
+                * @param kernel The kernel to be applied.
+                * @param padding_type The padding type to be applied.
+                * @param channel_mask The channels to be convolved (the other ones are copied through, e.g. alpha).
+            */
+            ConvolutionPlan(const int width, const int height, const int channels, const bool is_SoA, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO, const uint32_t channel_mask = ALL_CHANNELS);
+
+            // The channels point to the kernel copies of the plan: plans are not copyable.
+            ConvolutionPlan(const ConvolutionPlan&) = delete;
+            ConvolutionPlan& operator=(const ConvolutionPlan&) = delete;
+
+
+            // Methods.
+
+            /*
+                * Convolve an image with the planned dimensions and architecture.
+                *
+                * @param input The image to be convolved.
+                * @param output The output image (reallocated only if its dimensions or architecture differ).
+            */
+            void execute(const Image& input, Image& output);
+
+
+        private:
+            // Image dimensions.
+            int width, height, channels;
+
+            // Image architecture.
+            bool is_SoA;
+
+            // Kernels (copied, with their cached properties) and kernel of each channel (NULL to copy the channel through).
+            std::vector<Kernel> kernel_copies;
+            std::vector<const Kernel*> kernels;
+
+            // Padding type.
+            PaddingType padding_type;
+
+            // Convolved channels.
+            uint32_t channel_mask = 0;
+
+            // Source column of every padded column and source row of every padded row.
+            std::vector<int> column_table, row_table;
+
+            // Scratch SoA copy of AoS inputs.
+            Image planes;
+
+            // Scratch SoA padded image.
+            Image padded_image;
     };
 }
 
@@ -0,0 +1,355 @@
+#ifndef EXPRESSION_SEQUENTIAL_H
+#define EXPRESSION_SEQUENTIAL_H
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <sys/stat.h>
+
+#include "../image.h"
+#include "../kernel.h"
+#include "../params.h"
+#include "../utils.h"
+#include "../thread_pool.h"
+#include "convolution.h"
+
+
+namespace Sequential {
+    // Lazy pixel expression: each row of its terms is loaded (e.g. convolved) once, then every pixel of the row is computed
+    // inline by the expression tree, so only the result of the whole expression is materialised.
+    template <typename Derived>
+    class PixelExpression {
+        public:
+            /*
+                * Get the concrete expression.
+                *
+                * @return The concrete expression.
+            */
+            const Derived& self() const { return static_cast<const Derived&>(*this); }
+    };
+
+
+    // Terms.
+
+    class ImageTerm : public PixelExpression<ImageTerm> {
+        public:
+            /*
+                * Create a term reading the pixels of an image.
+                *
+                * @param image The image to be read (its buffer is shared).
+            */
+            ImageTerm(const Image& image) : image(image) {}
+
+            /*
+                * Load a row of a channel (read in place in SoA architecture, gathered from the pixels in AoS architecture).
+                *
+                * @param channel The channel of the row.
+                * @param y The row index.
+            */
+            void load_row(const int channel, const int y) {
+                const int width = image.get_width(); // Image width.
+                if (image.get_is_SoA()) {
+                    row = image.get_data() + (size_t)channel * width * image.get_height() + (size_t)y * width;
+                } else {
+                    const int channels = image.get_channels(); // Image channels.
+                    const uint8_t* pixels = image.get_data() + (size_t)y * width * channels + channel; // Samples of the row.
+                    samples.resize(width);
+                    for (int x = 0; x < width; x++) { samples[x] = pixels[(size_t)x * channels]; }
+                    row = samples.data();
+                }
+            }
+
+            float operator[](const int x) const { return row[x]; }
+
+            const Image* get_image() const { return &image; }
+
+        private:
+            // Image (const, so that its pixels are read through the const accessor and its buffer stays shared).
+            const Image image;
+
+            // Gathered samples of the loaded row (AoS architecture only).
+            std::vector<uint8_t> samples;
+
+            // Loaded row.
+            const uint8_t* row = NULL;
+    };
+
+    class ConvolutionTerm : public PixelExpression<ConvolutionTerm> {
+        public:
+            /*
+                * Create a term convolving an image (each row being convolved when loaded, from a window of padded rows of its channel).
+                *
+                * @param image The image to be convolved.
+                * @param kernel The kernel to be applied.
+                * @param padding_type The padding type to be applied.
+            */
+            ConvolutionTerm(const Image& image, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO);
+
+            /*
+                * Convolve a row of a channel (the padded rows of the previous row of the channel are reused).
+                *
+                * @param channel The channel of the row.
+                * @param y The row index.
+            */
+            void load_row(const int channel, const int y);
+
+            float operator[](const int x) const { return values[x]; }
+
+            const Image* get_image() const { return &image; }
+
+        private:
+            // Image (const, so that its pixels are read through the const accessor and its buffer stays shared).
+            const Image image;
+
+            // Kernel (shared by the copies of the term).
+            std::shared_ptr<const Kernel> kernel;
+
+            // Source column and row of every padded position (-1 for zero padding).
+            std::vector<int> column_table, row_table;
+
+            // Window of consecutive padded rows of a channel, its channel, first padded row and number of rows.
+            std::vector<uint8_t> window;
+            int window_channel = -1, window_first = 0, window_rows = 0;
+
+            // Convolved row (unclamped).
+            std::vector<float> values;
+
+            /*
+                * Pad a row of a channel.
+                *
+                * @param channel The channel of the row.
+                * @param padded_y The padded row index.
+                * @param output The padded row.
+            */
+            void pad_row(const int channel, const int padded_y, uint8_t* output) const;
+    };
+
+    class ConstantTerm : public PixelExpression<ConstantTerm> {
+        public:
+            ConstantTerm(const float value) : value(value) {}
+
+            void load_row(const int, const int) {}
+
+            float operator[](const int) const { return value; }
+
+            const Image* get_image() const { return NULL; }
+
+        private:
+            // Constant value.
+            float value;
+    };
+
+
+    // Operations.
+
+    struct SumOperation { static float apply(const float a, const float b) { return a + b; } };
+    struct DifferenceOperation { static float apply(const float a, const float b) { return a - b; } };
+    struct ProductOperation { static float apply(const float a, const float b) { return a * b; } };
+    struct AbsOperation { static float apply(const float a) { return std::fabs(a); } };
+
+    template <typename Left, typename Right, typename Operation>
+    class BinaryTerm : public PixelExpression<BinaryTerm<Left, Right, Operation>> {
+        public:
+            BinaryTerm(const Left& left, const Right& right) : left(left), right(right) {
+                // Check if the images of both operands have the same dimensions.
+                const Image *left_image = left.get_image(), *right_image = right.get_image(); // Images of the operands.
+                if (left_image != NULL && right_image != NULL && (left_image->get_width() != right_image->get_width() || left_image->get_height() != right_image->get_height() || left_image->get_channels() != right_image->get_channels())) {
+                    std::cerr << "Error: The images of the expression have different dimensions." << std::endl;
+                    throw std::invalid_argument("Mismatched expression images.");
+                }
+            }
+
+            void load_row(const int channel, const int y) { left.load_row(channel, y); right.load_row(channel, y); }
+
+            float operator[](const int x) const { return Operation::apply(left[x], right[x]); }
+
+            const Image* get_image() const { return left.get_image() != NULL ? left.get_image() : right.get_image(); }
+
+        private:
+            // Operands (copied, so that every thread loads its own rows).
+            Left left;
+            Right right;
+    };
+
+    template <typename Operand, typename Operation>
+    class UnaryTerm : public PixelExpression<UnaryTerm<Operand, Operation>> {
+        public:
+            UnaryTerm(const Operand& operand) : operand(operand) {}
+
+            void load_row(const int channel, const int y) { operand.load_row(channel, y); }
+
+            float operator[](const int x) const { return Operation::apply(operand[x]); }
+
+            const Image* get_image() const { return operand.get_image(); }
+
+        private:
+            // Operand.
+            Operand operand;
+    };
+
+    template <typename Operand>
+    class ClampTerm : public PixelExpression<ClampTerm<Operand>> {
+        public:
+            ClampTerm(const Operand& operand, const float min_value, const float max_value) : operand(operand), min_value(min_value), max_value(max_value) {}
+
+            void load_row(const int channel, const int y) { operand.load_row(channel, y); }
+
+            float operator[](const int x) const { return std::min(std::max(operand[x], min_value), max_value); }
+
+            const Image* get_image() const { return operand.get_image(); }
+
+        private:
+            // Operand.
+            Operand operand;
+
+            // Clamp range.
+            float min_value, max_value;
+    };
+
+
+    // Expression builders.
+
+    inline ImageTerm term(const Image& image) { return ImageTerm(image); }
+
+    inline ConvolutionTerm convolved(const Image& image, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO) { return ConvolutionTerm(image, kernel, padding_type); }
+
+    // The expressions read 8 bits images only: the other sample types are rejected at compile time.
+    template <typename T>
+    ImageTerm term(const BasicImage<T>& image) {
+        static_assert(std::is_same<T, uint8_t>::value, "Expressions support 8 bits images only.");
+        return ImageTerm(image);
+    }
+
+    template <typename T>
+    ConvolutionTerm convolved(const BasicImage<T>& image, const Kernel& kernel, const PaddingType padding_type = PaddingType::ZERO) {
+        static_assert(std::is_same<T, uint8_t>::value, "Expressions support 8 bits images only.");
+        return ConvolutionTerm(image, kernel, padding_type);
+    }
+
+    template <typename L, typename R>
+    BinaryTerm<L, R, SumOperation> operator+(const PixelExpression<L>& left, const PixelExpression<R>& right) { return BinaryTerm<L, R, SumOperation>(left.self(), right.self()); }
+
+    template <typename L>
+    BinaryTerm<L, ConstantTerm, SumOperation> operator+(const PixelExpression<L>& left, const float right) { return BinaryTerm<L, ConstantTerm, SumOperation>(left.self(), ConstantTerm(right)); }
+
+    template <typename L, typename R>
+    BinaryTerm<L, R, DifferenceOperation> operator-(const PixelExpression<L>& left, const PixelExpression<R>& right) { return BinaryTerm<L, R, DifferenceOperation>(left.self(), right.self()); }
+
+    template <typename L>
+    BinaryTerm<L, ConstantTerm, DifferenceOperation> operator-(const PixelExpression<L>& left, const float right) { return BinaryTerm<L, ConstantTerm, DifferenceOperation>(left.self(), ConstantTerm(right)); }
+
+    template <typename L, typename R>
+    BinaryTerm<L, R, ProductOperation> operator*(const PixelExpression<L>& left, const PixelExpression<R>& right) { return BinaryTerm<L, R, ProductOperation>(left.self(), right.self()); }
+
+    template <typename L>
+    BinaryTerm<L, ConstantTerm, ProductOperation> operator*(const PixelExpression<L>& left, const float right) { return BinaryTerm<L, ConstantTerm, ProductOperation>(left.self(), ConstantTerm(right)); }
+
+    template <typename R>
+    BinaryTerm<ConstantTerm, R, ProductOperation> operator*(const float left, const PixelExpression<R>& right) { return BinaryTerm<ConstantTerm, R, ProductOperation>(ConstantTerm(left), right.self()); }
+
+    template <typename E>
+    UnaryTerm<E, AbsOperation> absolute(const PixelExpression<E>& operand) { return UnaryTerm<E, AbsOperation>(operand.self()); }
+
+    template <typename E>
+    ClampTerm<E> clamped(const PixelExpression<E>& operand, const float min_value = 0.0f, const float max_value = 255.0f) { return ClampTerm<E>(operand.self(), min_value, max_value); }
+
+
+    // Evaluation.
+
+    /*
+        * Evaluate an expression in a single pass over the rows of its images and measure the execution time.
+        * The expression is clamped to [0, 255] when stored.
+        *
+        * @param expression The expression to be evaluated.
+        * @param results_path The path to save the results.
+        *
+        * @return The evaluated image, with the dimensions and architecture of the images of the expression.
+    */
+    template <typename E>
+    Image evaluate(const PixelExpression<E>& expression, std::string results_path = "") {
+        // Check if the expression reads an image.
+        const Image* image = expression.self().get_image(); // First image of the expression.
+        if (image == NULL) {
+            std::cerr << "Error: The expression does not read any image." << std::endl;
+            throw std::invalid_argument("Expression without images.");
+        }
+
+        // Get the image dimensions.
+        const int width = image->get_width(); // Image width.
+        const int height = image->get_height(); // Image height.
+        const int channels = image->get_channels(); // Image channels.
+        const bool is_SoA = image->get_is_SoA(); // Image architecture.
+
+        // Initialize the output image data (first touched by the threads writing its bands).
+        Image output_image = Image::uninitialized(width, height, channels, is_SoA); // Output image.
+        uint8_t* output_data = output_image.get_data(); // Output image data.
+        const size_t pixels = (size_t)width * height; // Number of pixels.
+        const int output_stride = is_SoA ? 1 : channels; // Distance between the pixels of a channel.
+
+
+        // Print the execution information.
+        if (VERBOSITY >= 1) std::cout << "Starting sequential expression evaluation..." << std::endl;
+
+        // Execution time.
+        float execution_time = 0;
+        for (int i = 0; i < ITERATIONS; i++) {
+            // Start iteration execution time.
+            auto start_time = std::chrono::high_resolution_clock::now();
+            if (VERBOSITY >= 2) std::cout << "\tIteration: " << i;
+
+            // Iterate over the image in bands of rows, processed by the CPU threads.
+            const int band_rows = std::max(1, Convolution::get_band_size() / std::max(1, width * channels)); // Rows per band.
+            ThreadPool::get_instance().parallel_for(height, band_rows, [&](const int begin, const int end) {
+                E local = expression.self(); // Copy of the expression, loading the rows of the thread.
+                std::vector<float> values(width); // Values of a row.
+
+                for (int channel = 0; channel < channels; channel++) {
+                    uint8_t* output = output_data + (is_SoA ? channel * pixels : channel); // Output channel.
+
+                    for (int y = begin; y < end; y++) {
+                        local.load_row(channel, y);
+
+                        // Compute every pixel of the row with the inlined expression tree.
+                        #pragma omp simd
+                        for (int x = 0; x < width; x++) { values[x] = std::min(std::max(local[x], 0.0f), 255.0f); }
+
+                        uint8_t* row = output + (size_t)y * width * output_stride; // Output row.
+                        for (int x = 0; x < width; x++) { row[(size_t)x * output_stride] = (uint8_t)values[x]; }
+                    }
+                }
+            });
+
+            // End iteration execution time.
+            auto end_time = std::chrono::high_resolution_clock::now();
+
+            // Measure the iteration execution time.
+            float iteration_execution_time = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+            execution_time += iteration_execution_time;
+
+            // Print the iteration execution time.
+            if (VERBOSITY >= 2) std::cout << " - Execution: " << iteration_execution_time << " ms" << std::endl;
+        }
+
+        // Print the execution time.
+        if (VERBOSITY >= 1) std::cout << "Execution time: " << execution_time / ITERATIONS << " ms (average of " << ITERATIONS << " runs)" << std::endl;
+
+
+        // Save the results.
+        if (!results_path.empty()) {
+            std::string execution_type = "expression";
+            save_results(results_path, execution_type, width, height, channels, is_SoA, 1, 1, execution_time / ITERATIONS, ITERATIONS);
+        }
+
+
+        // Return the evaluated image.
+        return output_image;
+    }
+}
+
+#endif // EXPRESSION_SEQUENTIAL_H
@@ -0,0 +1,435 @@
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <list>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#include "jit.h"
+#include "../isa.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#define JIT_X86_64 1
+#else
+#define JIT_X86_64 0
+#endif
+
+
+// Helpers.
+
+static const int JIT_MAX_DIVISOR = 64; // Largest divisor of the smallest weight tried as the common scale of integer weights.
+static const int JIT_MAX_INTEGER = 4096; // Largest integer weight (up to the common scale).
+static const int JIT_CACHE_SIZE = 64; // Largest number of compiled codes kept in the cache (the least recently used one is evicted first).
+
+// Factor the tap weights into integers times a common scale (up to the float rounding of the weights), so that the taps can be
+// accumulated in integer arithmetic without overflow.
+static bool factor_weights(const std::vector<KernelTap>& taps, float& scale, std::vector<int>& integers) {
+    if (taps.empty()) { return false; }
+
+    // Smallest weight magnitude.
+    float smallest = std::fabs(taps[0].weight);
+    for (const KernelTap& tap : taps) { smallest = std::min(smallest, std::fabs(tap.weight)); }
+
+    // Try the divisions of the smallest weight as the common scale.
+    for (int divisor = 1; divisor <= JIT_MAX_DIVISOR; divisor++) {
+        const double candidate = (double)smallest / divisor; // Candidate scale.
+        long long total = 0; // Sum of the integer magnitudes.
+        integers.clear();
+
+        for (const KernelTap& tap : taps) {
+            const double quotient = tap.weight / candidate; // Weight in units of the scale.
+            const long long integer = std::llround(quotient); // Nearest integer.
+            if (std::llabs(integer) > JIT_MAX_INTEGER || (float)integer * (float)candidate != tap.weight) { break; }
+
+            integers.push_back((int)integer);
+            total += std::llabs(integer);
+        }
+
+        // Every weight is a multiple of the scale, and the sums of 8 bits samples fit 32 bits.
+        if (integers.size() == taps.size() && total * 255 < (1ll << 31)) {
+            scale = (float)candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+// Assembler.
+
+// Vector instructions of the row functions, in their SSE (destructive) or AVX2 (VEX encoded, non destructive) form.
+enum class VectorOperation { PADDD, PSUBD, PMULLD, CVTDQ2PS, MULPS, ADDPS, SUBPS, PXOR };
+
+// Minimal x86-64 encoder of the row functions: vector registers 0 to 7, and the rax (pixel index), rdi (input), rsi (values) and
+// rdx (count) general purpose registers only, so that no REX prefix is needed except for the 64 bits operations.
+class Assembler {
+    public:
+        // Constructors.
+
+        /*
+            * Create an assembler.
+            *
+            * @param is_avx2 Whether to emit 256-bit AVX2 instructions instead of 128-bit SSE4.1 ones.
+        */
+        explicit Assembler(const bool is_avx2) : is_avx2(is_avx2) {}
+
+
+        // Methods.
+
+        // Vector operation dst = dst op src.
+        void operation(const VectorOperation operation, const int dst, const int src) {
+            const Encoding encoding = encode(operation); // Operation encoding.
+            prefix(encoding.has_66, encoding.is_0f38, encoding.is_nds ? dst : -1);
+            byte(encoding.opcode);
+            byte((uint8_t)(0xC0 | (dst << 3) | src));
+        }
+
+        // Vector operation dst = dst op constant (RIP relative broadcast constant).
+        void operation(const VectorOperation operation, const int dst, const uint32_t constant) {
+            const Encoding encoding = encode(operation); // Operation encoding.
+            prefix(encoding.has_66, encoding.is_0f38, encoding.is_nds ? dst : -1);
+            byte(encoding.opcode);
+            byte((uint8_t)(0x05 | (dst << 3)));
+            fixups.push_back(std::make_pair(code.size(), add_constant(constant)));
+            dword(0);
+        }
+
+        // Load the 8 bits samples at [rdi + rax + displacement] zero extended to 32 bits (pmovzxbd).
+        void load_samples(const int dst, const int32_t displacement) {
+            prefix(true, true, -1);
+            byte(0x31);
+            byte((uint8_t)(0x84 | (dst << 3))); // [base + index + disp32].
+            byte(0x07); // Base rdi, index rax.
+            dword((uint32_t)displacement);
+        }
+
+        // Shift the 32 bits lanes left (pslld).
+        void shift_left(const int reg, const int bits) {
+            prefix(true, false, reg);
+            byte(0x72);
+            byte((uint8_t)(0xC0 | (6 << 3) | reg));
+            byte((uint8_t)bits);
+        }
+
+        // Store the floats at [rsi + rax * 4 + displacement] (movups).
+        void store_values(const int src, const int8_t displacement) {
+            prefix(false, false, -1);
+            byte(0x11);
+            byte((uint8_t)(0x44 | (src << 3))); // [base + index * 4 + disp8].
+            byte(0x86); // Base rsi, index rax, scale 4.
+            byte((uint8_t)displacement);
+        }
+
+        // Function prologue: return if rdx <= 0, then start the pixel loop at rax = 0.
+        void begin_loop() {
+            bytes({0x48, 0x85, 0xD2}); // test rdx, rdx.
+            bytes({0x0F, 0x8E}); // jle end.
+            exit_jump = code.size();
+            dword(0);
+            bytes({0x31, 0xC0}); // xor eax, eax.
+            loop_start = code.size();
+        }
+
+        // Function epilogue: advance rax by the pixels of an iteration, loop while rax < rdx, then return.
+        void end_loop(const int pixels) {
+            bytes({0x48, 0x83, 0xC0, (uint8_t)pixels}); // add rax, pixels.
+            bytes({0x48, 0x39, 0xD0}); // cmp rax, rdx.
+            bytes({0x0F, 0x8C}); // jl loop.
+            dword((uint32_t)(loop_start - (code.size() + 4)));
+
+            // Exit.
+            const size_t exit = code.size(); // Exit address.
+            patch(exit_jump, (uint32_t)(exit - (exit_jump + 4)));
+            if (is_avx2) { bytes({0xC5, 0xF8, 0x77}); } // vzeroupper.
+            byte(0xC3); // ret.
+        }
+
+        /*
+            * Append the constants (32 bytes aligned) and resolve their RIP relative addresses.
+            *
+            * @return The machine code.
+        */
+        std::vector<uint8_t> finalize() {
+            while (code.size() % 32 != 0) { byte(0xCC); }
+            const size_t constants_start = code.size(); // Address of the first constant.
+            for (const uint32_t constant : constants) {
+                for (int lane = 0; lane < 8; lane++) { dword(constant); }
+            }
+
+            for (const std::pair<size_t, size_t>& fixup : fixups) {
+                patch(fixup.first, (uint32_t)(constants_start + fixup.second * 32 - (fixup.first + 4)));
+            }
+
+            return code;
+        }
+
+
+    private:
+        // Encoding of a vector operation.
+        struct Encoding {
+            bool has_66; // Whether the operation has the 66 prefix.
+            bool is_0f38; // Whether the opcode is in the 0F 38 map (0F otherwise).
+            uint8_t opcode; // Opcode.
+            bool is_nds; // Whether the VEX form reads the destination as its first source.
+        };
+
+        // Whether to emit AVX2 instructions.
+        bool is_avx2;
+
+        // Machine code.
+        std::vector<uint8_t> code;
+
+        // Broadcast constants, and the displacements (position, constant index) referencing them.
+        std::vector<uint32_t> constants;
+        std::vector<std::pair<size_t, size_t>> fixups;
+
+        // Position of the loop start and of the displacement of the exit jump.
+        size_t loop_start = 0, exit_jump = 0;
+
+
+        static Encoding encode(const VectorOperation operation) {
+            switch (operation) {
+                case VectorOperation::PADDD: return {true, false, 0xFE, true};
+                case VectorOperation::PSUBD: return {true, false, 0xFA, true};
+                case VectorOperation::PMULLD: return {true, true, 0x40, true};
+                case VectorOperation::CVTDQ2PS: return {false, false, 0x5B, false};
+                case VectorOperation::MULPS: return {false, false, 0x59, true};
+                case VectorOperation::ADDPS: return {false, false, 0x58, true};
+                case VectorOperation::SUBPS: return {false, false, 0x5C, true};
+                default: return {true, false, 0xEF, true};
+            }
+        }
+
+        // Emit the legacy prefixes and escape bytes, or the VEX prefix (vvvv is the first source register, -1 if unused).
+        void prefix(const bool has_66, const bool is_0f38, const int vvvv) {
+            if (!is_avx2) {
+                if (has_66) { byte(0x66); }
+                byte(0x0F);
+                if (is_0f38) { byte(0x38); }
+                return;
+            }
+
+            const uint8_t inverted_vvvv = (uint8_t)((~(vvvv < 0 ? 0 : vvvv) & 0xF) << 3); // Inverted first source register.
+            const uint8_t length_pp = (uint8_t)(0x04 | (has_66 ? 0x01 : 0x00)); // 256-bit length and implied prefix.
+            if (is_0f38) {
+                bytes({0xC4, 0xE2, (uint8_t)(inverted_vvvv | length_pp)}); // 3 bytes VEX (inverted R, X, B set, map 0F 38, W0).
+            } else {
+                bytes({0xC5, (uint8_t)(0x80 | inverted_vvvv | length_pp)}); // 2 bytes VEX (inverted R set, map 0F).
+            }
+        }
+
+        size_t add_constant(const uint32_t constant) {
+            const auto found = std::find(constants.begin(), constants.end(), constant); // Shared constant.
+            if (found != constants.end()) { return found - constants.begin(); }
+            constants.push_back(constant);
+            return constants.size() - 1;
+        }
+
+        void byte(const uint8_t value) { code.push_back(value); }
+
+        void bytes(const std::initializer_list<uint8_t> values) { code.insert(code.end(), values); }
+
+        void dword(const uint32_t value) {
+            for (int i = 0; i < 4; i++) { code.push_back((uint8_t)(value >> (8 * i))); }
+        }
+
+        void patch(const size_t position, const uint32_t value) {
+            for (int i = 0; i < 4; i++) { code[position + i] = (uint8_t)(value >> (8 * i)); }
+        }
+};
+
+static uint32_t float_bits(const float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+
+// Executable code.
+
+struct Sequential::Jit::Code {
+    // Compiled kernel (the weights are compared on hash collisions), padded width and instruction set.
+    uint64_t hash = 0;
+    int width = 0, height = 0, padded_width = 0;
+    bool is_avx2 = false;
+    std::vector<float> weights;
+
+    // Executable memory.
+    void* memory = NULL;
+    size_t size = 0;
+
+    // Row function.
+    JitRow row;
+
+    ~Code() {
+#if JIT_X86_64
+        if (memory != NULL) { munmap(memory, size); }
+#endif
+    }
+};
+
+
+// Methods.
+
+bool Sequential::Jit::is_supported() {
+    // The row functions use SSE4.1 instructions (zero extension and 32 bits multiplication) or AVX2 ones, and the 512-bit row
+    // primitives outrun their 256-bit code.
+    const InstructionSet instruction_set = Isa::get_instruction_set(); // Active instruction set.
+    return JIT_X86_64 && (instruction_set == InstructionSet::SSE4_2 || instruction_set == InstructionSet::AVX2);
+}
+
+Sequential::JitRow Sequential::Jit::compile(const Kernel& kernel, const int padded_width) {
+    if (!is_supported()) { return JitRow(); }
+
+    // Compiled codes, the most recently used first (the row functions returned keep their code alive once evicted).
+    static std::mutex mutex;
+    static std::list<std::shared_ptr<Code>> cache;
+
+    const bool is_avx2 = Isa::get_instruction_set() == InstructionSet::AVX2; // Whether to emit AVX2 instructions.
+    const uint64_t hash = kernel.get_hash(); // Kernel hash.
+    const std::vector<float> weights(kernel.get_data(), kernel.get_data() + kernel.get_width() * kernel.get_height()); // Kernel weights.
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Look the kernel up (comparing the weights in case of hash collisions), and move it to the front.
+    for (auto entry = cache.begin(); entry != cache.end(); entry++) {
+        const std::shared_ptr<Code> code = *entry; // Cached code.
+        if (code->hash == hash && code->padded_width == padded_width && code->is_avx2 == is_avx2 && code->width == kernel.get_width() && code->height == kernel.get_height() && code->weights == weights) {
+            cache.splice(cache.begin(), cache, entry);
+            JitRow row = code->row; // Row function, keeping its code alive.
+            row.code = code;
+            return row;
+        }
+    }
+
+    // Compile the kernel, evicting the least recently used code.
+    const std::shared_ptr<Code> code = generate(kernel, padded_width, is_avx2);
+    if (!code) { return JitRow(); }
+    cache.push_front(code);
+    if ((int)cache.size() > JIT_CACHE_SIZE) { cache.pop_back(); }
+
+    JitRow row = code->row; // Row function, keeping its code alive.
+    row.code = code;
+    return row;
+}
+
+std::shared_ptr<Sequential::Jit::Code> Sequential::Jit::generate(const Kernel& kernel, const int padded_width, const bool is_avx2) {
+#if JIT_X86_64
+    const std::shared_ptr<const KernelProperties> properties = kernel.get_properties(); // Kernel properties.
+    const std::vector<KernelTap>& taps = properties->taps; // Non-zero taps.
+    if (taps.empty()) { return NULL; }
+
+    // Integer weights up to a common scale are accumulated as integers, the other ones as floats.
+    float scale = 1.0f; // Common scale of the integer weights.
+    std::vector<int> integers; // Integer weights.
+    const bool is_integer = factor_weights(taps, scale, integers);
+
+    // Group the taps sharing their weight, so that their samples are summed before being scaled.
+    std::vector<std::pair<uint32_t, std::vector<int32_t>>> groups; // (Weight bits or integer weight, sample displacements).
+    for (size_t t = 0; t < taps.size(); t++) {
+        const uint32_t weight = is_integer ? (uint32_t)integers[t] : float_bits(taps[t].weight); // Tap weight.
+        const int32_t displacement = taps[t].dy * padded_width + taps[t].dx; // Tap sample displacement.
+
+        auto group = std::find_if(groups.begin(), groups.end(), [weight](const std::pair<uint32_t, std::vector<int32_t>>& g) { return g.first == weight; });
+        if (group == groups.end()) {
+            groups.push_back(std::make_pair(weight, std::vector<int32_t>()));
+            group = groups.end() - 1;
+        }
+        group->second.push_back(displacement);
+    }
+
+    // Each iteration computes two vectors of pixels, in independent registers: accumulators 0 and 3, group sums 1 and 4, samples 2 and 5.
+    const int lanes = is_avx2 ? 8 : 4; // Pixels per vector.
+    const int accumulator[2] = {0, 3}, sum[2] = {1, 4}, sample[2] = {2, 5}; // Registers of each vector.
+
+    Assembler assembler(is_avx2);
+    assembler.begin_loop();
+    for (int v = 0; v < 2; v++) { assembler.operation(VectorOperation::PXOR, accumulator[v], accumulator[v]); }
+
+    for (const std::pair<uint32_t, std::vector<int32_t>>& group : groups) {
+        // Sum the samples of the taps of the group.
+        for (size_t t = 0; t < group.second.size(); t++) {
+            for (int v = 0; v < 2; v++) {
+                const int32_t displacement = group.second[t] + v * lanes; // Displacement of the samples of the vector.
+                if (t == 0) {
+                    assembler.load_samples(sum[v], displacement);
+                } else {
+                    assembler.load_samples(sample[v], displacement);
+                    assembler.operation(VectorOperation::PADDD, sum[v], sample[v]);
+                }
+            }
+        }
+
+        // Scale the sum by the group weight and accumulate it.
+        for (int v = 0; v < 2; v++) {
+            if (is_integer) {
+                const int integer = (int)group.first; // Integer weight.
+                const int magnitude = std::abs(integer); // Integer weight magnitude.
+                if ((magnitude & (magnitude - 1)) == 0) {
+                    // Power of two weights are shifts.
+                    int bits = 0;
+                    while ((1 << bits) < magnitude) { bits++; }
+                    if (bits > 0) { assembler.shift_left(sum[v], bits); }
+                    assembler.operation(integer > 0 ? VectorOperation::PADDD : VectorOperation::PSUBD, accumulator[v], sum[v]);
+                } else {
+                    assembler.operation(VectorOperation::PMULLD, sum[v], (uint32_t)integer);
+                    assembler.operation(VectorOperation::PADDD, accumulator[v], sum[v]);
+                }
+            } else {
+                const uint32_t weight = group.first; // Weight bits.
+                assembler.operation(VectorOperation::CVTDQ2PS, sum[v], sum[v]);
+                if (weight == float_bits(-1.0f)) {
+                    assembler.operation(VectorOperation::SUBPS, accumulator[v], sum[v]);
+                } else {
+                    if (weight != float_bits(1.0f)) { assembler.operation(VectorOperation::MULPS, sum[v], weight); }
+                    assembler.operation(VectorOperation::ADDPS, accumulator[v], sum[v]);
+                }
+            }
+        }
+    }
+
+    // Convert the integer sums and apply the common scale, then store the values.
+    for (int v = 0; v < 2; v++) {
+        if (is_integer) {
+            assembler.operation(VectorOperation::CVTDQ2PS, accumulator[v], accumulator[v]);
+            if (scale != 1.0f) { assembler.operation(VectorOperation::MULPS, accumulator[v], float_bits(scale)); }
+        }
+        assembler.store_values(accumulator[v], (int8_t)(v * lanes * 4));
+    }
+    assembler.end_loop(2 * lanes);
+    const std::vector<uint8_t> machine_code = assembler.finalize(); // Machine code.
+
+    // Copy the code into executable memory (never writable and executable at once).
+    const std::shared_ptr<Code> code = std::make_shared<Code>();
+    code->size = machine_code.size();
+    code->memory = mmap(NULL, code->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code->memory == MAP_FAILED) {
+        code->memory = NULL;
+        std::cerr << "Warning: Could not allocate the code of the kernel, falling back to the generic engine." << std::endl;
+        return NULL;
+    }
+    memcpy(code->memory, machine_code.data(), code->size);
+    if (mprotect(code->memory, code->size, PROT_READ | PROT_EXEC) != 0) {
+        std::cerr << "Warning: Could not make the code of the kernel executable, falling back to the generic engine." << std::endl;
+        return NULL;
+    }
+
+    code->hash = kernel.get_hash();
+    code->width = kernel.get_width();
+    code->height = kernel.get_height();
+    code->padded_width = padded_width;
+    code->is_avx2 = is_avx2;
+    code->weights.assign(kernel.get_data(), kernel.get_data() + kernel.get_width() * kernel.get_height());
+    code->row.function = (void (*)(const uint8_t*, float*, const int64_t))code->memory;
+    code->row.pixels = 2 * lanes;
+
+    return code;
+#else
+    (void)kernel; (void)padded_width; (void)is_avx2;
+    return NULL;
+#endif
+}
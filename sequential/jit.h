@@ -0,0 +1,66 @@
+#ifndef JIT_SEQUENTIAL_H
+#define JIT_SEQUENTIAL_H
+
+#include <stdint.h>
+#include <memory>
+
+#include "../kernel.h"
+
+
+namespace Sequential {
+    // Row function compiled for a kernel and a padded image width.
+    struct JitRow {
+        // Convolve the first count pixels of a row (a multiple of pixels), input pointing to the padded pixel of the first one.
+        void (*function)(const uint8_t* input, float* values, const int64_t count) = NULL;
+
+        // Pixels computed per iteration.
+        int pixels = 0;
+
+        // Executable code of the function (kept alive while the row function is used, even once evicted from the cache).
+        std::shared_ptr<const void> code;
+    };
+
+    // Compiler of kernels into x86-64 machine code: the weights are folded into the instructions, zero taps are dropped, the taps
+    // sharing a weight are summed before being scaled, integer weights (up to a common scale) are accumulated in integer arithmetic
+    // with power of two weights turned into shifts, and the stencil is fully unrolled.
+    class Jit {
+        public:
+            // Methods.
+
+            /*
+                * Check if kernels can be compiled (x86-64 Linux build and SSE4.2 or AVX2 active instruction set).
+                *
+                * @return Whether kernels can be compiled.
+            */
+            static bool is_supported();
+
+            /*
+                * Get the row function of a kernel, compiled on the first request and cached by kernel hash (the JIT_CACHE_SIZE most
+                * recently used codes are kept).
+                *
+                * @param kernel The kernel to be compiled.
+                * @param padded_width The padded image width (the row offsets of the taps are folded into the code).
+                *
+                * @return The row function (without function when the kernel cannot be compiled).
+            */
+            static JitRow compile(const Kernel& kernel, const int padded_width);
+
+
+        private:
+            // Executable code of a kernel.
+            struct Code;
+
+            /*
+                * Generate the code of a kernel.
+                *
+                * @param kernel The kernel to be compiled.
+                * @param padded_width The padded image width.
+                * @param is_avx2 Whether to emit AVX2 (16 pixels per iteration) or SSE4.1 (8 pixels per iteration) instructions.
+                *
+                * @return The code, or NULL if the kernel cannot be compiled.
+            */
+            static std::shared_ptr<Code> generate(const Kernel& kernel, const int padded_width, const bool is_avx2);
+    };
+}
+
+#endif // JIT_SEQUENTIAL_H
@@ -0,0 +1,46 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+
+#include "../image.h"
+#include "../kernel.h"
+#include "../sequential/convolution.h"
+#include "../sequential/expression.h"
+
+/*
+    * Check that evaluating an expression reads its images in place: the pixel buffers of the images stay shared with the caller.
+    *
+    * Build and run from the project directory:
+    * g++ -fopenmp -march=x86-64-v2 tests/expression_test.cpp image.cpp kernel.cpp isa.cpp thread_pool.cpp sequential/convolution.cpp sequential/jit.cpp -o expression_test && ./expression_test
+*/
+int main() {
+    const int width = 97, height = 61, channels = 3; // Image dimensions.
+    std::vector<uint8_t> pixels((size_t)width * height * channels); // Image pixels.
+    for (size_t i = 0; i < pixels.size(); i++) { pixels[i] = (uint8_t)((i * 37) ^ (i >> 5)); }
+
+    int failures = 0; // Number of failed checks.
+    for (int is_SoA = 0; is_SoA < 2; is_SoA++) {
+        Image image(width, height, channels, pixels.data(), false); // Image read by the expressions.
+        if (is_SoA) { image = image.converted(true); }
+        const uint8_t* data = static_cast<const Image&>(image).get_data(); // Shared pixel buffer.
+
+        Sequential::evaluate(Sequential::clamped(Sequential::term(image) * 2.0f - Sequential::convolved(image, Kernel::gaussian_blur_kernel(), PaddingType::MIRROR)));
+
+        // The caller's image must still point to the same buffer (no copy was detached from it).
+        if (static_cast<const Image&>(image).get_data() != data) {
+            std::cerr << "Error: The image buffer was copied by the evaluation (" << (is_SoA ? "SoA" : "AoS") << " architecture)." << std::endl;
+            failures++;
+        }
+
+        // The terms of the expression must read the same buffer as the caller's image.
+        Sequential::ImageTerm image_term = Sequential::term(image); // Term reading the image.
+        image_term.load_row(0, 0);
+        if (image_term.get_image()->get_data() != data) {
+            std::cerr << "Error: The image term does not share the image buffer (" << (is_SoA ? "SoA" : "AoS") << " architecture)." << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << (failures == 0 ? "Expression buffer sharing: passed." : "Expression buffer sharing: failed.") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include <iostream>
+#include <vector>
+#include <cstdint>
+
+#include "../image.h"
+#include "../kernel.h"
+#include "../sequential/convolution.h"
+
+/*
+    * Check that a fused pipeline gives the same image as the chained convolutions of its stages, with every padding type
+    * (the intermediate stages must pad their input at the image borders as the chained convolutions do).
+    *
+    * Build and run from the project directory:
+    * g++ -fopenmp -march=x86-64-v2 tests/fused_test.cpp image.cpp kernel.cpp isa.cpp thread_pool.cpp sequential/convolution.cpp sequential/jit.cpp -o fused_test && ./fused_test
+*/
+int main() {
+    const int width = 97, height = 61, channels = 3; // Image dimensions.
+    std::vector<uint8_t> pixels((size_t)width * height * channels); // Image pixels.
+    for (size_t i = 0; i < pixels.size(); i++) { pixels[i] = (uint8_t)((i * 37) ^ (i >> 5)); }
+
+    // Chains of kernels, applied in order.
+    std::vector<float> ramp(49); // Weights of a 7x7 kernel.
+    for (int i = 0; i < 49; i++) { ramp[i] = (float)(i % 5 + 1); }
+    const std::vector<std::vector<Kernel>> chains = {
+        {Kernel::gaussian_blur_kernel(), Kernel::sharpen_kernel()},
+        {Kernel::custom_kernel(7, ramp.data()), Kernel::emboss_kernel(), Kernel::box_blur_kernel()},
+    };
+    const char* padding_names[] = {"ZERO", "REPLICATE", "MIRROR"}; // Names of the padding types.
+
+    int failures = 0; // Number of failed checks.
+    for (int is_SoA = 0; is_SoA < 2; is_SoA++) {
+        Image image(width, height, channels, pixels.data(), false); // Filtered image.
+        if (is_SoA) { image = image.converted(true); }
+
+        for (size_t c = 0; c < chains.size(); c++) {
+            for (int padding = 0; padding < 3; padding++) {
+                const PaddingType padding_type = (PaddingType)padding; // Padding type.
+
+                // Filter the image by the chained convolutions and by the fused pipeline.
+                std::vector<Sequential::PipelineStage> stages; // Stages of the pipeline.
+                Image chained = image; // Image filtered by the chained convolutions.
+                for (const Kernel& kernel : chains[c]) {
+                    stages.push_back(Sequential::PipelineStage::convolution(kernel));
+                    chained = Sequential::Convolution::convolve(chained, kernel, padding_type);
+                }
+                const Image fused = Sequential::Convolution::convolve_fused(image, stages, padding_type); // Image filtered by the pipeline.
+
+                // Count the differing samples.
+                int differences = 0; // Number of differing samples.
+                for (int channel = 0; channel < channels; channel++) {
+                    for (int y = 0; y < height; y++) {
+                        for (int x = 0; x < width; x++) { differences += (fused(x, y, channel) != chained(x, y, channel)); }
+                    }
+                }
+                if (differences > 0) {
+                    std::cerr << "Error: " << differences << " samples of the fused chain " << c << " differ from the chained convolutions (" << padding_names[padding] << " padding, " << (is_SoA ? "SoA" : "AoS") << " architecture)." << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+
+    std::cout << (failures == 0 ? "Fused pipeline equality: passed." : "Fused pipeline equality: failed.") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
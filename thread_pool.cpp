@@ -0,0 +1,251 @@
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "thread_pool.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// Whether the current thread is processing a band (nested jobs run inline).
+static thread_local bool is_in_band = false;
+
+
+// Constructors and destructor.
+
+ThreadPool::ThreadPool() {
+    // Detect the NUMA nodes.
+    for (const std::vector<int>& cpus : detect_nodes()) {
+        nodes.emplace_back(new Node());
+        nodes.back()->cpus = cpus;
+    }
+
+    // Start a thread per hardware thread.
+    configure(0);
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+
+// Getters.
+
+ThreadPool& ThreadPool::get_instance() {
+    static ThreadPool instance;
+    return instance;
+}
+
+int ThreadPool::get_thread_count() const {
+    return (int)workers.size() + 1;
+}
+
+int ThreadPool::get_node_count() const {
+    return (int)nodes.size();
+}
+
+bool ThreadPool::is_running_band() {
+    return is_in_band;
+}
+
+
+// Methods.
+
+void ThreadPool::configure(const int thread_count, const bool pin_threads) {
+    std::lock_guard<std::mutex> job_lock(job_mutex);
+
+    // Stop the current worker threads.
+    stop();
+    is_stopping = false;
+
+    // The calling thread processes the bands of the first node, the workers are spread over the nodes. Unpinned threads may run
+    // on any node, so their bands are shared through the queue of the first node.
+    const int threads = (thread_count > 0) ? thread_count : std::max(1, (int)std::thread::hardware_concurrency()); // Number of threads.
+#if defined(__linux__)
+    queue_count = pin_threads ? (int)nodes.size() : 1;
+#else
+    queue_count = 1;
+#endif
+    for (int i = 1; i < threads; i++) {
+        const int node = i % queue_count; // NUMA node of the worker.
+        workers.emplace_back(&ThreadPool::worker_loop, this, node);
+
+#if defined(__linux__)
+        // Pin the worker to a CPU of its node.
+        const std::vector<int>& cpus = nodes[node]->cpus;
+        if (pin_threads && !cpus.empty()) {
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(cpus[(i / nodes.size()) % cpus.size()], &cpu_set);
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(cpu_set_t), &cpu_set);
+        }
+#else
+        (void)pin_threads;
+#endif
+    }
+
+#ifdef _OPENMP
+    // The OpenMP loops (e.g. the layout conversions) use the same number of threads.
+    omp_set_num_threads(threads);
+#endif
+}
+
+void ThreadPool::parallel_for(const int rows, const int band_rows, const std::function<void(int, int)>& band) {
+    if (rows <= 0) { return; }
+    const int rows_per_band = std::max(1, band_rows); // Rows per band.
+
+    // Run inline without workers, for a single band, or when called from a band.
+    if (workers.empty() || rows <= rows_per_band || is_in_band) {
+        for (int begin = 0; begin < rows; begin += rows_per_band) {
+            band(begin, std::min(begin + rows_per_band, rows));
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> job_lock(job_mutex);
+
+    // Queue every band on the node owning its rows.
+    const int bands = (rows + rows_per_band - 1) / rows_per_band; // Number of bands.
+    job = &band;
+    remaining = bands;
+    for (int begin = 0; begin < rows; begin += rows_per_band) {
+        Node& node = *nodes[(long long)begin * queue_count / rows];
+        std::lock_guard<std::mutex> node_lock(node.mutex);
+        node.bands.emplace_back(begin, std::min(begin + rows_per_band, rows));
+    }
+
+    // Wake the workers up.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+    }
+    wake_condition.notify_all();
+
+    // Help with the bands, then wait for the ones still running.
+    while (run_band(0)) {}
+    std::unique_lock<std::mutex> lock(mutex);
+    done_condition.wait(lock, [this] { return remaining == 0; });
+
+    // Rethrow the first exception of the bands on the calling thread.
+    if (exception) {
+        std::exception_ptr band_exception = exception;
+        exception = NULL;
+        std::rethrow_exception(band_exception);
+    }
+}
+
+
+// Private methods.
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        is_stopping = true;
+    }
+    wake_condition.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::worker_loop(const int node) {
+    unsigned long long seen_generation = 0; // Last job generation processed.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        seen_generation = generation;
+    }
+
+    while (true) {
+        // Wait for a new job.
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake_condition.wait(lock, [&] { return is_stopping || generation != seen_generation; });
+            if (is_stopping) { return; }
+            seen_generation = generation;
+        }
+
+        // Process the bands of the job.
+        while (run_band(node)) {}
+    }
+}
+
+bool ThreadPool::run_band(const int node) {
+    std::pair<int, int> band; // First and last row of the band.
+    bool is_found = false; // Whether a band was found.
+
+    // Pop a band of the node, or steal one from the back of the other nodes.
+    for (size_t i = 0; i < nodes.size() && !is_found; i++) {
+        Node& victim = *nodes[(node + i) % nodes.size()];
+        std::lock_guard<std::mutex> node_lock(victim.mutex);
+        if (!victim.bands.empty()) {
+            if (i == 0) {
+                band = victim.bands.front();
+                victim.bands.pop_front();
+            } else {
+                band = victim.bands.back();
+                victim.bands.pop_back();
+            }
+            is_found = true;
+        }
+    }
+    if (!is_found) { return false; }
+
+    // Process the band (an exception is kept for the calling thread of the job, whose other bands still run).
+    is_in_band = true;
+    try {
+        (*job)(band.first, band.second);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!exception) { exception = std::current_exception(); }
+    }
+    is_in_band = false;
+
+    // Signal the completion of the last band.
+    if (remaining.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done_condition.notify_all();
+    }
+
+    return true;
+}
+
+std::vector<std::vector<int>> ThreadPool::detect_nodes() {
+    std::vector<std::vector<int>> nodes; // CPUs of each node.
+
+#if defined(__linux__)
+    // Read the CPU list (e.g. "0-7,16-23") of each node.
+    for (int node = 0; ; node++) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file.is_open()) { break; }
+
+        std::vector<int> cpus; // CPUs of the node.
+        std::string range; // CPU range.
+        while (std::getline(file, range, ',')) {
+            int first = 0, last = -1; // First and last CPU of the range.
+            char separator = 0; // Range separator.
+            std::stringstream ss(range);
+            if (!(ss >> first)) { continue; }
+            last = (ss >> separator >> last) ? last : first;
+            for (int cpu = first; cpu <= last; cpu++) { cpus.push_back(cpu); }
+        }
+
+        // Skip the memory only nodes.
+        if (!cpus.empty()) { nodes.push_back(cpus); }
+    }
+#endif
+
+    // Fall back to a single node.
+    if (nodes.empty()) { nodes.emplace_back(); }
+
+    return nodes;
+}
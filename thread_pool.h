@@ -0,0 +1,159 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+
+class ThreadPool {
+    public:
+        // Constructors and destructor.
+
+        // Stop and join the worker threads.
+        ~ThreadPool();
+
+
+        // Getters.
+
+        /*
+            * Get the process wide thread pool (one thread per hardware thread until configured).
+            *
+            * @return The thread pool.
+        */
+        static ThreadPool& get_instance();
+
+        /*
+            * Get the number of threads (the calling thread included).
+            *
+            * @return The number of threads.
+        */
+        int get_thread_count() const;
+
+        /*
+            * Get the number of NUMA nodes.
+            *
+            * @return The number of NUMA nodes.
+        */
+        int get_node_count() const;
+
+        /*
+            * Get whether the calling thread is processing a band (e.g. to run the nested OpenMP loops on that thread only).
+            *
+            * @return Whether the calling thread is processing a band.
+        */
+        static bool is_running_band();
+
+
+        // Methods.
+
+        /*
+            * Restart the worker threads.
+            *
+            * @param thread_count The number of threads, the calling thread included (0 for one per hardware thread, 1 to run on the calling thread only).
+            * @param pin_threads Whether to pin each worker thread to a CPU of its NUMA node (the bands are queued per node only then,
+            *                    and in a single queue otherwise).
+        */
+        void configure(const int thread_count, const bool pin_threads = false);
+
+        /*
+            * Process the rows of an image in bands, returning when every band is done (rethrowing the first exception of a band).
+            * With pinned threads, each band is queued on the NUMA node owning its share of the rows, so that the same rows are always
+            * first touched and processed on the same node, and idle threads steal the bands queued on the other nodes.
+            *
+            * @param rows The number of rows.
+            * @param band_rows The number of rows per band.
+            * @param band The band function, called with the first and last (excluded) row of the band.
+        */
+        void parallel_for(const int rows, const int band_rows, const std::function<void(int, int)>& band);
+
+
+    private:
+        // Band queue of a NUMA node.
+        struct Node {
+            // CPUs of the node.
+            std::vector<int> cpus;
+
+            // Mutex guarding the queue.
+            std::mutex mutex;
+
+            // Queued bands (first and last row), popped from the front by the node threads and stolen from the back.
+            std::deque<std::pair<int, int>> bands;
+        };
+
+        // NUMA nodes.
+        std::vector<std::unique_ptr<Node>> nodes;
+
+        // Number of node queues in use (one per node with pinned threads, a single one otherwise).
+        int queue_count = 1;
+
+        // Worker threads.
+        std::vector<std::thread> workers;
+
+        // Mutex guarding the job generation, and conditions signaling a new job and its completion.
+        std::mutex mutex;
+        std::condition_variable wake_condition, done_condition;
+
+        // Mutex serializing the jobs.
+        std::mutex job_mutex;
+
+        // Current band function.
+        const std::function<void(int, int)>* job = NULL;
+
+        // Job generation, incremented for every job.
+        unsigned long long generation = 0;
+
+        // Number of bands of the current job not yet done.
+        std::atomic<int> remaining{0};
+
+        // First exception thrown by a band of the current job (guarded by the mutex).
+        std::exception_ptr exception;
+
+        // Whether the worker threads are stopping.
+        bool is_stopping = false;
+
+
+        // Constructors.
+
+        // Detect the NUMA nodes and start a thread per hardware thread.
+        ThreadPool();
+
+
+        // Methods.
+
+        /*
+            * Stop and join the worker threads.
+        */
+        void stop();
+
+        /*
+            * Wait for jobs and process their bands.
+            *
+            * @param node The NUMA node of the thread.
+        */
+        void worker_loop(const int node);
+
+        /*
+            * Pop a band of the node (or steal one from the other nodes) and process it.
+            *
+            * @param node The NUMA node of the thread.
+            *
+            * @return Whether a band was processed.
+        */
+        bool run_band(const int node);
+
+        /*
+            * Detect the CPUs of each NUMA node (a single node with every CPU if the topology is not available).
+            *
+            * @return The CPUs of each node.
+        */
+        static std::vector<std::vector<int>> detect_nodes();
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,175 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "tuner.h"
+#include "./parallel/convolution.h"
+#include "./sequential/convolution.h"
+
+
+// Methods.
+
+std::string Tuner::signature(const std::string& execution_type, const Image& image, const Kernel& kernel) {
+    std::stringstream ss;
+    ss << execution_type << "_" << image.get_width() << "x" << image.get_height() << "x" << image.get_channels();
+    ss << "_k" << std::max(kernel.get_width(), kernel.get_height());
+
+    return ss.str();
+}
+
+TuningConfig Tuner::heuristic(const std::string& execution_type, const Image& image, const Kernel& kernel) {
+    TuningConfig config;
+
+    if (execution_type == "sequential") {
+        // The row engines read channel planes and write rows of a channel: SoA avoids the strided stores.
+        config.is_SoA = (image.get_channels() > 1);
+        config.band_size = BAND_SIZE;
+    } else {
+        // The shared memory tiles need the kernel in constant memory.
+        config.is_SoA = false;
+        config.memory_type = (kernel.get_width() <= MAX_MASK_WIDTH && kernel.get_height() <= MAX_MASK_WIDTH) ? "shared" : "global";
+    }
+
+    return config;
+}
+
+TuningConfig Tuner::get_config(const std::string& execution_type, const Image& image, const Kernel& kernel, const std::string& cache_path) {
+    TuningConfig config;
+    if (!lookup(cache_path, signature(execution_type, image, kernel), config)) {
+        config = heuristic(execution_type, image, kernel);
+    }
+
+    return config;
+}
+
+TuningConfig Tuner::tune(const std::string& execution_type, const Image& image, const Kernel& kernel, const PaddingType padding_type, const uint32_t channel_mask, const std::string& cache_path) {
+    // Candidate configurations (the padding type is not a candidate: it changes the output, and has a single implementation).
+    std::vector<TuningConfig> candidates;
+    for (const bool is_SoA : {false, true}) {
+        // Single channel images have the same layout in both architectures.
+        if (is_SoA && image.get_channels() == 1) { continue; }
+
+        if (execution_type == "sequential") {
+            for (const int band_size : {BAND_SIZE / 4, BAND_SIZE, BAND_SIZE * 4, BAND_SIZE * 16}) {
+                TuningConfig config;
+                config.is_SoA = is_SoA;
+                config.band_size = band_size;
+                candidates.push_back(config);
+            }
+        } else {
+            // The constant, shared and pinned memory types need the kernel in constant memory.
+            const bool is_constant_kernel = (kernel.get_width() <= MAX_MASK_WIDTH && kernel.get_height() <= MAX_MASK_WIDTH);
+            for (const char* memory_type : {"global", "constant", "shared", "pinned"}) {
+                if (!is_constant_kernel && std::string(memory_type) != "global") { continue; }
+
+                TuningConfig config;
+                config.is_SoA = is_SoA;
+                config.memory_type = memory_type;
+                candidates.push_back(config);
+            }
+        }
+    }
+
+    // Benchmark the candidates: an untimed warm-up run pays the one-time costs (e.g. CUDA context, cached padded copies, cold caches),
+    // then the fastest of TUNING_RUNS timed runs is kept.
+    const int previous_band_size = Sequential::Convolution::get_band_size(); // Band size to be restored.
+    TuningConfig best_config = heuristic(execution_type, image, kernel); // Fastest configuration.
+    float best_time = -1; // Fastest execution time.
+    for (const TuningConfig& config : candidates) {
+        const Image candidate_image = image.converted(config.is_SoA); // Image in the candidate architecture.
+
+        float execution_time = -1; // Candidate execution time.
+        for (int run = 0; run <= TUNING_RUNS; run++) {
+            auto start_time = std::chrono::high_resolution_clock::now();
+            if (execution_type == "sequential") {
+                Sequential::Convolution::set_band_size(config.band_size);
+                Sequential::Convolution::convolve(candidate_image, kernel, padding_type, "", channel_mask);
+            } else if (config.memory_type == "global") {
+                Parallel::Convolution::convolve_global(candidate_image, kernel, padding_type, "", channel_mask);
+            } else if (config.memory_type == "constant") {
+                Parallel::Convolution::convolve_constant(candidate_image, kernel, padding_type, "", channel_mask);
+            } else if (config.memory_type == "shared") {
+                Parallel::Convolution::convolve_shared(candidate_image, kernel, padding_type, "", channel_mask);
+            } else {
+                Parallel::Convolution::convolve_pinned(candidate_image, kernel, padding_type, "", 3, channel_mask);
+            }
+            auto end_time = std::chrono::high_resolution_clock::now();
+
+            // Skip the warm-up run.
+            const float run_time = std::chrono::duration<float, std::milli>(end_time - start_time).count(); // Run execution time.
+            if (run > 0 && (execution_time < 0 || run_time < execution_time)) { execution_time = run_time; }
+        }
+
+        if (VERBOSITY >= 1) {
+            std::cout << "Tuning " << (config.is_SoA ? "SoA" : "AoS") << ", ";
+            if (execution_type == "sequential") std::cout << "band size " << config.band_size;
+            else std::cout << "memory type " << config.memory_type;
+            std::cout << ": " << execution_time << " ms" << std::endl;
+        }
+
+        if (best_time < 0 || execution_time < best_time) {
+            best_time = execution_time;
+            best_config = config;
+        }
+    }
+
+    // Restore the previous band size and store the fastest configuration.
+    Sequential::Convolution::set_band_size(previous_band_size);
+    store(cache_path, signature(execution_type, image, kernel), best_config);
+
+    return best_config;
+}
+
+
+// Private methods.
+
+bool Tuner::lookup(const std::string& cache_path, const std::string& signature, TuningConfig& config) {
+    std::ifstream file(cache_path);
+    if (!file.is_open()) { return false; }
+
+    // Each line holds a signature and its configuration: <signature> <SoA> <band size> <memory type>.
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        std::string line_signature;
+        TuningConfig line_config;
+        if ((ss >> line_signature >> line_config.is_SoA >> line_config.band_size >> line_config.memory_type) && line_signature == signature) {
+            config = line_config;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Tuner::store(const std::string& cache_path, const std::string& signature, const TuningConfig& config) {
+    // Read the cached configurations, keeping the other signatures.
+    std::map<std::string, std::string> lines; // Cache lines by signature.
+    std::ifstream input_file(cache_path);
+    std::string line;
+    while (std::getline(input_file, line)) {
+        std::stringstream ss(line);
+        std::string line_signature;
+        if (ss >> line_signature) { lines[line_signature] = line; }
+    }
+    input_file.close();
+
+    // Replace the configuration of the signature.
+    std::stringstream ss;
+    ss << signature << " " << config.is_SoA << " " << config.band_size << " " << config.memory_type;
+    lines[signature] = ss.str();
+
+    // Write the cache back.
+    std::ofstream output_file(cache_path, std::ios_base::trunc);
+    if (!output_file.is_open()) {
+        std::cerr << "Error: Cannot write the tuning cache: " << cache_path << "." << std::endl;
+        return;
+    }
+    for (const auto& entry : lines) {
+        output_file << entry.second << std::endl;
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <string>
+
+#include "params.h"
+#include "image.h"
+#include "kernel.h"
+
+
+// Tuned configuration of a convolution.
+struct TuningConfig {
+    // Image architecture.
+    bool is_SoA = false;
+
+    // Size in bytes of the row bands processed by each CPU thread (sequential execution type).
+    int band_size = BAND_SIZE;
+
+    // Memory management type (parallel execution type).
+    std::string memory_type = "global";
+};
+
+
+class Tuner {
+    public:
+        // Methods.
+
+        /*
+            * Get the tuning signature of a convolution.
+            *
+            * @param execution_type The execution type ('sequential' or 'parallel').
+            * @param image The image to be convolved.
+            * @param kernel The kernel to be applied.
+            *
+            * @return The signature (e.g. 'sequential_1920x1080x3_k5').
+        */
+        static std::string signature(const std::string& execution_type, const Image& image, const Kernel& kernel);
+
+        /*
+            * Get the heuristic configuration of a convolution, used when it is not tuned.
+            *
+            * @param execution_type The execution type ('sequential' or 'parallel').
+            * @param image The image to be convolved.
+            * @param kernel The kernel to be applied.
+            *
+            * @return The heuristic configuration.
+        */
+        static TuningConfig heuristic(const std::string& execution_type, const Image& image, const Kernel& kernel);
+
+        /*
+            * Get the configuration of a convolution from the tuning cache, or the heuristic one on a cache miss.
+            *
+            * @param execution_type The execution type ('sequential' or 'parallel').
+            * @param image The image to be convolved.
+            * @param kernel The kernel to be applied.
+            * @param cache_path The path of the tuning cache file.
+            *
+            * @return The configuration.
+        */
+        static TuningConfig get_config(const std::string& execution_type, const Image& image, const Kernel& kernel, const std::string& cache_path = TUNING_CACHE_PATH);
+
+        /*
+            * Benchmark the candidate configurations of a convolution and store the fastest one in the tuning cache.
+            *
+            * @param execution_type The execution type ('sequential' or 'parallel').
+            * @param image The image to be convolved.
+            * @param kernel The kernel to be applied.
+            * @param padding_type The padding type to be applied.
+            * @param channel_mask The channels to be convolved.
+            * @param cache_path The path of the tuning cache file.
+            *
+            * @return The fastest configuration.
+        */
+        static TuningConfig tune(const std::string& execution_type, const Image& image, const Kernel& kernel, const PaddingType padding_type, const uint32_t channel_mask = ALL_CHANNELS, const std::string& cache_path = TUNING_CACHE_PATH);
+
+
+    private:
+        /*
+            * Look a configuration up in the tuning cache.
+            *
+            * @param cache_path The path of the tuning cache file.
+            * @param signature The signature of the convolution.
+            * @param config The configuration found.
+            *
+            * @return Whether the configuration was found.
+        */
+        static bool lookup(const std::string& cache_path, const std::string& signature, TuningConfig& config);
+
+        /*
+            * Store a configuration in the tuning cache, replacing the one with the same signature.
+            *
+            * @param cache_path The path of the tuning cache file.
+            * @param signature The signature of the convolution.
+            * @param config The configuration to be stored.
+        */
+        static void store(const std::string& cache_path, const std::string& signature, const TuningConfig& config);
+};
+
+#endif // TUNER_H